@@ -13,12 +13,66 @@
 
 typedef uint64_t unique_id_t;
 
+/* Classes of event which can be selected with OTTER_EVENTS */
+typedef enum {
+    otter_event_parallel    = 1 << 0,   // parallel regions & implicit tasks
+    otter_event_tasks       = 1 << 1,   // explicit task creation & scheduling
+    otter_event_sync        = 1 << 2,   // taskwait, taskgroup & reduction
+    otter_event_barrier     = 1 << 3,   // explicit & implicit barriers
+    otter_event_workshare   = 1 << 4,   // loop, sections, single, taskloop
+    otter_event_master      = 1 << 5,   // master/masked
+    otter_event_all         = (1 << 6) - 1
+} otter_event_class_t;
+
+/* Recording of lock & mutual-exclusion construct contention (OTTER_LOCKS) */
+typedef enum {
+    otter_locks_off,
+    otter_locks_aggregate,      // per-mutex statistics reported at finalise
+    otter_locks_trace           // also write an event for each release
+} otter_locks_mode_t;
+
+/* Recording of loop chunks & sections dispatched to threads (OTTER_DISPATCH) */
+typedef enum {
+    otter_dispatch_off,
+    otter_dispatch_aggregate,   // per-thread totals on each workshare region
+    otter_dispatch_chunks       // also write an event for each chunk
+} otter_dispatch_mode_t;
+
+/* Performance counters which can be selected with OTTER_COUNTERS */
+typedef enum {
+    otter_counter_task_clock        = 1 << 0,
+    otter_counter_context_switches  = 1 << 1,
+    otter_counter_cpu_migrations    = 1 << 2,
+    otter_counter_page_faults       = 1 << 3,
+    otter_counter_cycles            = 1 << 4,
+    otter_counter_instructions      = 1 << 5,
+    otter_counter_llc_misses        = 1 << 6,
+    otter_counter_software          = (1 << 4) - 1,
+    otter_counter_hardware          = (1 << 7) - (1 << 4)
+} otter_counter_t;
+
 typedef struct otter_opt_t {
     char    *hostname;
     char    *tracename;
     char    *tracepath;
     char    *archive_name;
     bool     append_hostname;
+    uint64_t start_after;       // ns before tracing is first activated
+    uint64_t duration;          // ns for which tracing stays active (0=always)
+    unsigned int sample_parallel;       // trace 1 in N parallel regions
+    unsigned int sample_parallel_first; // trace the first K parallel regions
+    double       sample_tasks;          // fraction of root task subtrees traced
+    unsigned int task_max_depth;        // deepest task traced (0=no limit)
+    unsigned int events;                // otter_event_class_t flags
+    unsigned int throttle_rate;         // task events/s/thread (0=never)
+    uint64_t     throttle_duration;     // ns, mean task duration to throttle
+    uint64_t     elide_threshold;       // ns, shortest region written (0=all)
+    unsigned int callstacks;            // capture 1 in N call stacks (0=never)
+    unsigned int locks;                 // otter_locks_mode_t
+    unsigned int dispatch;              // otter_dispatch_mode_t
+    unsigned int counters;              // otter_counter_t flags (0=none)
+    bool         noise;                 // sample per-thread scheduler stats
+    unsigned int granularity;           // min. task cost / creation cost
 } otter_opt_t;
 
 #endif // OTTER_COMMON_H
@@ -148,6 +148,16 @@ on_ompt_callback_device_unload(
 );
 #endif
 
+#if defined(implements_callback_dispatch)
+static void
+on_ompt_callback_dispatch(
+    ompt_data_t             *parallel,
+    ompt_data_t             *task,
+    ompt_dispatch_t          kind,
+    ompt_data_t              instance
+);
+#endif
+
 #if defined(implements_callback_sync_region_wait)
 static void
 on_ompt_callback_sync_region_wait(
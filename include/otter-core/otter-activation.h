@@ -0,0 +1,18 @@
+#if !defined(OTTER_ACTIVATION_H)
+#define OTTER_ACTIVATION_H
+
+#include <stdbool.h>
+#include <otter-common.h>
+
+/* Whether constructs encountered by the initial task are traced. Only changed
+   by the initial thread at the boundaries of outermost parallel regions so that
+   every region entered while tracing is active is also left while active */
+extern bool tracing_active;
+
+/* Start the activation window and install the SIGUSR2 handler */
+void activation_setup(otter_opt_t *opt);
+
+/* Apply any pending change of activation state (window or signal) */
+void activation_update(void);
+
+#endif // OTTER_ACTIVATION_H
@@ -7,9 +7,28 @@
 #define ENV_VAR_TRACE_OUTPUT    "OTTER_TRACE_NAME"
 #define ENV_VAR_TRACE_PATH      "OTTER_TRACE_PATH"
 #define ENV_VAR_REPORT_CBK      "OTTER_REPORT_CALLBACKS"
+#define ENV_VAR_START_AFTER     "OTTER_START_AFTER"
+#define ENV_VAR_DURATION        "OTTER_DURATION"
+#define ENV_VAR_SAMPLE_PARALLEL "OTTER_SAMPLE_PARALLEL"
+#define ENV_VAR_SAMPLE_FIRST    "OTTER_SAMPLE_PARALLEL_FIRST"
+#define ENV_VAR_SAMPLE_TASKS    "OTTER_SAMPLE_TASKS"
+#define ENV_VAR_TASK_MAX_DEPTH  "OTTER_TASK_MAX_DEPTH"
+#define ENV_VAR_EVENTS          "OTTER_EVENTS"
+#define ENV_VAR_FILTER          "OTTER_FILTER"
+#define ENV_VAR_THROTTLE_RATE   "OTTER_THROTTLE_RATE"
+#define ENV_VAR_THROTTLE_DURATION "OTTER_THROTTLE_DURATION"
+#define ENV_VAR_ELIDE_THRESHOLD "OTTER_ELIDE_SHORTER_THAN"
+#define ENV_VAR_CALLSTACKS      "OTTER_CALLSTACKS"
+#define ENV_VAR_LOCKS           "OTTER_LOCKS"
+#define ENV_VAR_DISPATCH        "OTTER_DISPATCH"
+#define ENV_VAR_COUNTERS        "OTTER_COUNTERS"
+#define ENV_VAR_NOISE           "OTTER_NOISE"
+#define ENV_VAR_GRANULARITY     "OTTER_GRANULARITY"
 
 /* Default values */
 #define DEFAULT_OTF2_TRACE_OUTPUT "otter_trace"
 #define DEFAULT_OTF2_TRACE_PATH   "trace"
+#define DEFAULT_THROTTLE_DURATION 10000     // ns
+#define DEFAULT_GRANULARITY       10
 
 #endif // OTTER_ENV_H
\ No newline at end of file
@@ -0,0 +1,26 @@
+#if !defined(OTTER_FILTER_H)
+#define OTTER_FILTER_H
+
+#include <stdbool.h>
+
+/*  Filter constructs by their source location, read from the file named by
+    OTTER_FILTER. Each line of the file is a rule:
+
+        include|exclude  function  <glob>
+        include|exclude  file      <glob>[:<line>[-<line>]]
+        include|exclude  address   <start>[-<end>]
+
+    Rules are applied in order and the last matching rule decides. Constructs
+    matching no rule are included. Blank lines and lines starting with '#' are
+    ignored.
+ */
+
+/* Read the filter file (if any). Returns false on error */
+bool filter_initialise(const char *path);
+void filter_finalise(void);
+
+/* Whether the construct at codeptr_ra is traced. Resolved once per codeptr_ra,
+   after which this is a single lookup */
+bool filter_include(const void *codeptr_ra);
+
+#endif // OTTER_FILTER_H
@@ -0,0 +1,47 @@
+#if !defined(OTTER_GRANULARITY_H)
+#define OTTER_GRANULARITY_H
+
+#include <stdint.h>
+#include <otter-common.h>
+
+/*  Task granularity recommendations, reported at finalise if OTTER_GRANULARITY
+    is set. The cost of creating a task is estimated from the intervals between
+    consecutive tasks created by the same task with no task switch in between,
+    excluding the time spent in Otter's task-create callback. Each task
+    construct's tasks are compared to a multiple of that cost (OTTER_GRANULARITY)
+    by their depth, including the time spent in their descendants, to suggest
+    the depth beyond which tasks should be included and, for taskloops, a
+    grainsize. Each thread measures creation intervals in its own statistics,
+    which are merged when the thread ends.
+ */
+
+/* Task depths recorded separately for each construct. The last also counts
+   any deeper tasks */
+#define TASK_DEPTH_BINS 32
+
+/* Histogram bins (see histogram.h) of the intervals between task creations */
+#define CREATION_COST_BINS 32
+
+/* A thread's task creation intervals */
+typedef struct creation_stats_t creation_stats_t;
+
+void granularity_initialise(unsigned int multiple);
+
+/* Print the recommendations for each task construct */
+void granularity_print_summary(void);
+
+creation_stats_t *granularity_new_stats(void);
+
+/* Add a thread's intervals to the process-wide histogram & destroy its stats */
+void granularity_merge_stats(creation_stats_t *stats);
+
+/* The thread created a task in the task with the given ID. The timestamps
+   bound Otter's task-create callback, whose time isn't counted. Does nothing
+   if stats is NULL */
+void granularity_task_created(creation_stats_t *stats, unique_id_t creator,
+    uint64_t callback_begin, uint64_t callback_end);
+
+/* The thread switched task, so its next creation starts a new interval */
+void granularity_task_switch(creation_stats_t *stats);
+
+#endif // OTTER_GRANULARITY_H
@@ -0,0 +1,69 @@
+#if !defined(OTTER_LOCKS_H)
+#define OTTER_LOCKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <otter-ompt-header.h>
+
+/*  Contention statistics for locks and the critical, atomic & ordered
+    constructs, enabled with OTTER_LOCKS. Each thread records the mutexes it
+    acquires in its own table, which is merged into the process-wide table when
+    the thread ends, so recording an acquisition touches no shared state.
+ */
+
+/* Histogram bin k counts times in [2^k, 2^(k+1)) ns. The last bin also counts
+   any longer times */
+#define LOCK_HISTOGRAM_BINS 32
+
+/* Waits at least this long (ns) are counted as contended */
+#define LOCK_CONTENDED_THRESHOLD 1000
+
+/* Number of mutexes listed at finalise */
+#define LOCK_REPORT_TOP 10
+
+/* A mutex (wait_id) acquired at a particular code address */
+typedef struct lock_stats_t {
+    ompt_mutex_t    kind;
+    ompt_wait_id_t  wait_id;
+    const void     *codeptr_ra;
+    uint64_t        acquisitions;
+    uint64_t        contended;
+    uint64_t        wait_time;          // ns
+    uint64_t        max_wait;           // ns
+    uint64_t        hold_time;          // ns
+    uint64_t        max_hold;           // ns
+    uint64_t        wait_histogram[LOCK_HISTOGRAM_BINS];
+    uint64_t        hold_histogram[LOCK_HISTOGRAM_BINS];
+} lock_stats_t;
+
+/* A thread's table of lock statistics */
+typedef struct lock_table_t lock_table_t;
+
+void locks_initialise(void);
+void locks_finalise(void);
+
+/* Print the most contended mutexes across all merged tables */
+void locks_print_summary(void);
+
+lock_table_t *locks_new_table(void);
+
+/* Add a thread's statistics to the process-wide table & destroy its table */
+void locks_merge_table(lock_table_t *table);
+
+/* Record the site at which a lock was initialised */
+void locks_record_init(ompt_wait_id_t wait_id, const void *codeptr_ra);
+
+/* The thread has begun waiting for a mutex */
+void locks_acquire(lock_table_t *table);
+
+/* The thread now holds the mutex. Returns the time (ns) it waited */
+uint64_t locks_acquired(lock_table_t *table, ompt_mutex_t kind,
+    ompt_wait_id_t wait_id, const void *codeptr_ra);
+
+/* The thread released the mutex. Returns the statistics under which the
+   acquisition was recorded (NULL if it wasn't) and sets the time (ns) spent
+   waiting for and then holding the mutex */
+const lock_stats_t *locks_released(lock_table_t *table,
+    ompt_wait_id_t wait_id, uint64_t *wait_time, uint64_t *hold_time);
+
+#endif // OTTER_LOCKS_H
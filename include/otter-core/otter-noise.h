@@ -0,0 +1,36 @@
+#if !defined(OTTER_NOISE_H)
+#define OTTER_NOISE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*  Detection of OS noise, enabled with OTTER_NOISE. Each thread samples its
+    scheduler statistics at the boundaries of traced parallel regions: the time
+    it spent runnable but waiting for a CPU (from /proc/self/task/<tid>/schedstat)
+    and its involuntary context switches (from getrusage(RUSAGE_THREAD)). A
+    thread preempted since its last sample has a marker written in the trace.
+    Threads add their totals to a process-wide table when they end.
+ */
+
+/* A thread's noise statistics */
+typedef struct noise_stats_t noise_stats_t;
+
+void noise_finalise(void);
+
+/* Print each thread's totals */
+void noise_print_summary(void);
+
+/* Start sampling the calling thread */
+noise_stats_t *noise_new_stats(uint64_t thread_id);
+
+/* Take a sample. Returns true if the thread was preempted since the previous
+   sample, setting the number of preemptions & time (ns) spent waiting for a
+   CPU since then */
+bool noise_sample(noise_stats_t *stats, uint64_t *preemptions,
+    uint64_t *wait_time);
+
+/* Add a thread's totals (including its migrations between CPUs) to the
+   process-wide table & destroy its statistics */
+void noise_merge_stats(noise_stats_t *stats, uint64_t migrations);
+
+#endif // OTTER_NOISE_H
@@ -6,12 +6,106 @@
 #include <otter-ompt-header.h>
 #include <otter-core/otter.h>
 #include <otter-trace/trace.h>
+#include <otter-datatypes/hashmap.h>
+#include <otter-datatypes/stack.h>
+#include <otter-core/otter-locks.h>
+#include <otter-core/otter-noise.h>
+#include <otter-core/otter-granularity.h>
 
 /* forward declarations */
 typedef struct parallel_data_t parallel_data_t;
 typedef struct thread_data_t thread_data_t;
 typedef struct task_data_t task_data_t;
 typedef struct scope_t scope_t;
+typedef struct construct_data_t construct_data_t;
+typedef struct task_lineage_t task_lineage_t;
+
+/* Maximum number of distinct constructs (code addresses) recorded */
+#define CONSTRUCT_REGISTRY_CAPACITY 4096
+
+/* Number of completed tasks between checks for throttling a task construct */
+#define THROTTLE_CHECK_INTERVAL 64
+
+/* Barriers of a team whose arrivals may be recorded at once. As no thread can
+   pass a barrier before all have arrived, two are enough */
+#define BARRIER_ARRIVAL_SLOTS 2
+
+/* Number of barriers listed at finalise */
+#define BARRIER_REPORT_TOP 10
+
+/* A parallel region's tasks are producer-bound if one thread created at least
+   this percentage of them */
+#define TASK_PRODUCER_SHARE 90
+
+/* Capacity of each task's map of its children's dependence addresses to their
+   last writer. Addresses are only added while the map is at most half full */
+#define DEPENDENCE_MAP_CAPACITY 1024
+
+/* Capacity of each thread's set of the predecessors found for the last task
+   whose dependences it reported */
+#define SINK_PREDECESSORS_CAPACITY 64
+
+/* Construct */
+void constructs_initialise(void);
+void constructs_finalise(void);
+construct_data_t *get_construct_data(const void *codeptr_ra);
+bool construct_scan(construct_data_t **dest, size_t *next);
+struct construct_data_t {
+    const void         *codeptr_ra;
+    uint64_t            instances;
+    uint64_t            traced;
+    uint64_t            untraced;
+    uint64_t            untraced_time;      // ns
+    uint64_t            pending_skipped;    // untraced since last traced
+    uint64_t            pending_time;       // ns
+    uint64_t            first_seen;         // timestamp of registration
+    uint64_t            tasks;              // completed traced tasks
+    uint64_t            task_time;          // ns spent executing those tasks
+    bool                throttled;          // stop tracing task instances
+    uint64_t            throttled_tasks;
+    uint64_t            throttled_time;     // ns
+    uint64_t            started;            // explicit tasks started
+    uint64_t            stolen;             // started by another thread
+    uint64_t            start_latency;      // ns from creation to start
+    uint64_t            queued;             // tasks without dependences
+    uint64_t            queued_time;        // ns those tasks spent ready
+    uint64_t            latency_histogram[TASK_LATENCY_BINS];
+    uint64_t            teams;              // parallel regions begun
+    uint64_t            team_shortfall;     // given fewer threads than requested
+    uint64_t            oversubscribed;     // more OpenMP threads than CPUs
+    unsigned int        requested;          // most threads requested
+    unsigned int        min_team;           // fewest threads given
+    unsigned int        peak_threads;       // OpenMP threads in any team (max)
+    uint64_t            barriers;           // completed by the whole team
+    uint64_t            barrier_skew;       // ns from first to last arrival
+    uint64_t            max_barrier_skew;   // ns
+    uint64_t            barrier_wait;       // ns threads waited for the last
+    uint64_t            category_tasks[NUM_TASK_CATEGORIES];    // created
+    uint64_t            category_time[NUM_TASK_CATEGORIES];     // ns
+    uint64_t            depth_tasks[TASK_DEPTH_BINS];   // completed
+    uint64_t            depth_time[TASK_DEPTH_BINS];    // ns incl. descendants
+    uint64_t            taskloop_iterations;
+    uint64_t            producing_regions;  // traced, with explicit tasks
+    uint64_t            producer_bottlenecks;
+    uint64_t            producer_time;      // ns top producers in callbacks
+    uint64_t            starved_time;       // ns
+};
+
+/* Arrivals of a team's threads at one of its barriers */
+typedef struct barrier_arrivals_t {
+    unsigned int        arrived;
+    uint64_t            first;              // timestamp
+    uint64_t            last;               // timestamp
+    uint64_t            sum;                // of arrival timestamps
+} barrier_arrivals_t;
+
+/* Explicit tasks created by one member of a team */
+typedef struct task_producer_t {
+    uint64_t            tasks;
+    uint64_t            callback_time;      // ns in task-create & dependences
+    uint64_t            first;              // timestamp of first creation
+    uint64_t            last;               // timestamp of last creation
+} task_producer_t;
 
 /* Parallel */
 parallel_data_t *new_parallel_data(
@@ -19,13 +113,28 @@ parallel_data_t *new_parallel_data(
     unique_id_t encountering_task_id,
     task_data_t *encountering_task_data,
     unsigned int requested_parallelism,
-    int flags);
+    int flags,
+    construct_data_t *construct,
+    bool traced,
+    const void *codeptr_ra,
+    uint32_t callstack_id);
 void parallel_destroy(parallel_data_t *thread_data);
 struct parallel_data_t {
     unique_id_t         id;
     unique_id_t         master_thread;
     task_data_t        *encountering_task_data;
-    trace_region_def_t *region;
+    trace_region_def_t *region;             // NULL if not traced
+    construct_data_t   *construct;
+    bool                traced;
+    uint64_t            begin_time;         // only set if not traced
+    unsigned int        requested_parallelism;
+    unsigned int        peak_threads;       // OpenMP threads in any team (max)
+    unsigned int        team_size;          // actual parallelism
+    barrier_arrivals_t  arrivals[BARRIER_ARRIVAL_SLOTS];
+    task_producer_t    *producers;          // by team rank, NULL if untraced
+    uint64_t            tasks_completed;    // explicit tasks
+    uint64_t            completed_time;     // ns spent executing them
+    uint64_t            starved_time;       // ns idle until a task was ready
 };
 
 /* Thread */
@@ -36,16 +145,63 @@ struct thread_data_t {
     trace_location_def_t *location;
     ompt_thread_t         type;
     bool                  is_master_thread;   // of parallel region
+    double                subtree_credit;     // for task subtree sampling
+    unsigned int          callstack_events;   // for call stack sampling
+    lock_table_t         *locks;              // NULL unless OTTER_LOCKS set
+    noise_stats_t        *noise;              // NULL unless OTTER_NOISE set
+    unsigned int          team_rank;          // in innermost traced team
+    uint32_t              task_generation;    // of the last task created
+    unsigned int          implicit_depth;     // implicit tasks being executed
+    stack_t              *waiting_tasks;      // in traced taskwait/taskgroup
+    creation_stats_t     *creation;
+    uint64_t              idle_since;         // timestamp, 0 if not idle
+    parallel_data_t      *idle_parallel;      // of the task waiting idle
+    unique_id_t           dependence_sink;    // last task with dependences
+    hashmap_t            *sink_predecessors;  // its edges from last writers
+};
+
+/* A task's place in the task tree. The task's reference is released when it
+   completes and each child holds one until it completes in turn, so that a
+   task's ancestors can be found after they have completed */
+task_lineage_t *new_task_lineage(task_lineage_t *parent, unsigned int depth);
+void task_lineage_release(task_lineage_t *lineage);
+struct task_lineage_t {
+    task_lineage_t     *parent;             // NULL for implicit & initial tasks
+    unsigned int        depth;
+    unsigned int        refs;               // the task & its children
+    uint64_t            subtree_time;       // ns, of completed descendants
 };
 
 /* Task */
-task_data_t *new_task_data(trace_location_def_t *loc,trace_region_def_t *parent_task_region, unique_id_t task_id, ompt_task_flag_t flags, int has_dependences);
+task_data_t *new_task_data(trace_location_def_t *loc,trace_region_def_t *parent_task_region, unique_id_t task_id, ompt_task_flag_t flags, int has_dependences, unsigned int depth, task_data_t *traced_ancestor, const void *codeptr_ra, uint32_t callstack_id);
 void task_destroy(task_data_t *task_data);
 struct task_data_t {
     unique_id_t         id;
     ompt_task_flag_t    type;
     ompt_task_flag_t    flags;
     trace_region_def_t *region;
+    unsigned int        untraced_depth;     // regions entered while inactive
+    unsigned int        depth;              // 0 for implicit & initial tasks
+    task_data_t        *traced_ancestor;    // set if the task is sampled out
+    uint64_t            resume_time;        // sampled out or throttling
+    uint64_t            exec_time;          // ns, only when throttling
+    parallel_data_t    *parallel;           // innermost traced parallel region
+    construct_data_t   *construct;          // explicit tasks only
+    bool                throttled;
+    bool                has_dependences;
+    bool                started;
+    uint64_t            create_time;        // explicit tasks only
+    unique_id_t         creating_thread;
+    unsigned int        outer_team_rank;    // implicit tasks only
+    uint64_t            barriers;           // implicit tasks only
+    bool                waiting;            // in a sync region wait
+    hashmap_t          *last_writer;        // children's dependences -> task
+    hashmap_t          *sibling_writers;    // parent's, until deps reported
+    task_lineage_t     *lineage;
 };
 
+/* Whether task is a descendant of ancestor. False unless both have a
+   lineage */
+bool task_is_descendant(const task_data_t *task, const task_data_t *ancestor);
+
 #endif // OTTER_STRUCTS_H
@@ -37,7 +37,16 @@
 #define implements_callback_implicit_task
 #define implements_callback_work
 #define implements_callback_sync_region
+#define implements_callback_sync_region_wait
+#define implements_callback_dispatch
 #define implements_callback_master
+#define implements_callback_dependences
+#define implements_callback_task_dependence
+#define implements_callback_mutex_acquire
+#define implements_callback_mutex_acquired
+#define implements_callback_mutex_released
+#define implements_callback_lock_init
+#define implements_callback_lock_destroy
 #include <otter-core/ompt-callback-prototypes.h>
 
 /* Used as an array index to keep track of unique ids for different entities */
@@ -0,0 +1,41 @@
+#if !defined(OTTER_HASHMAP_H)
+#define OTTER_HASHMAP_H
+
+// Public
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <macros/debug.h>
+#include <otter-datatypes/datatypes-common.h>
+
+/* A fixed-capacity map from uint64_t keys to non-zero items. Lookups and
+   insertions are lock-free so a map may be shared between threads. Items
+   can't be removed individually once inserted. */
+typedef struct hashmap_t hashmap_t;
+
+hashmap_t  *hashmap_create(size_t capacity);
+bool        hashmap_find(hashmap_t *m, uint64_t key, data_item_t *dest);
+size_t      hashmap_size(hashmap_t *m);
+void        hashmap_destroy(hashmap_t *m, bool items, data_destructor_t destructor);
+
+/* insert item under key unless key already maps to an item. Returns the item
+   stored under key, which is not the one passed in if another thread inserted
+   first, or a null item if the map is full */
+data_item_t hashmap_insert(hashmap_t *m, uint64_t key, data_item_t item);
+
+/* store item under key, replacing any item already stored there. Returns the
+   replaced item, or a null item if there was none or the map is full */
+data_item_t hashmap_exchange(hashmap_t *m, uint64_t key, data_item_t item);
+
+/* remove every entry. Not thread-safe: the caller must have exclusive access */
+void hashmap_clear(hashmap_t *m);
+
+/* scan through the items in a map without modifying the map
+   write the key & item of the current entry to key & dest
+   [next] holds the position to resume from and should start at 0
+   returns false once there are no more entries
+*/
+bool hashmap_scan(hashmap_t *m, uint64_t *key, data_item_t *dest, size_t *next);
+
+#endif // OTTER_HASHMAP_H
@@ -0,0 +1,19 @@
+#if !defined(OTTER_HISTOGRAM_H)
+#define OTTER_HISTOGRAM_H
+
+// Public
+
+#include <stdint.h>
+
+/* Histograms with power-of-two bins: bin k counts values in [2^k, 2^(k+1)) and
+   bin 0 also counts 0. The last bin also counts any larger values */
+
+unsigned int histogram_bin(uint64_t value, unsigned int n_bins);
+void         histogram_add(uint64_t *histogram, unsigned int n_bins,
+                 uint64_t value);
+
+/* Upper bound of the bin containing the p-th percentile (0 <= p <= 1) */
+uint64_t     histogram_percentile(const uint64_t *histogram,
+                 unsigned int n_bins, double p);
+
+#endif // OTTER_HISTOGRAM_H
@@ -41,14 +41,51 @@ INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, encountering_task_id, "unique ID of the task
 
 /* Attributes relating to parallel regions */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT32, requested_parallelism, "requested parallelism of parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT32, actual_parallelism, "number of threads in the team of parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, team_shortfall, "the team has fewer threads than requested")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT32, peak_threads, "most OpenMP threads executing in any team while this region's team began")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, oversubscribed, "more OpenMP threads were executing than there are online CPUs while this region's team began")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, barriers, "number of barriers in this parallel region at which the whole team arrived")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, barrier_skew, "total time (ns) from the first to the last thread arriving at each barrier")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, max_barrier_skew, "longest time (ns) from the first to the last thread arriving at a barrier")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, barrier_wait, "total time (ns) threads spent waiting at barriers for the last thread to arrive")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, tasks_deferred, "number of deferred explicit tasks created in this parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, tasks_undeferred, "number of undeferred explicit tasks (e.g. if(0)) created in this parallel region, excluding final and merged tasks")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, tasks_final, "number of final or included explicit tasks created in this parallel region, excluding merged tasks")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, tasks_merged, "number of merged explicit tasks created in this parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, deferred_task_time, "time (ns) spent executing deferred explicit tasks in this parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, undeferred_task_time, "time (ns) spent executing undeferred explicit tasks in this parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, final_task_time, "time (ns) spent executing final or included explicit tasks in this parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, merged_task_time, "time (ns) spent executing merged explicit tasks in this parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT32, task_producers, "number of threads in the team which created explicit tasks in this parallel region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, top_producer_tasks, "number of explicit tasks created by the thread which created the most")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, producer_time, "time (ns) the thread which created the most tasks spent inside Otter's task-creation callbacks")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_creation_rate, "tasks per second created by the thread which created the most, from its first to its last task")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_consumption_rate, "tasks per second the team could execute, from the number of threads and the mean task duration")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_starved_time, "total time (ns) threads waited idle in barriers and taskwaits before a task became ready to execute")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, producer_bottleneck, "one thread created most tasks, more slowly than the team could execute them, while other threads waited for work")
 INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, is_league, "is this parallel region a league of teams?")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, skipped_instances, "instances of this parallel construct sampled out since the last traced instance")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, skipped_time, "total duration (ns) of the sampled-out instances")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, throttled_tasks, "number of tasks in this parallel region whose events were throttled")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, throttled_task_time, "total time (ns) spent executing throttled tasks")
 
 /* Attributes relating to workshare regions (sections, single, loop, taskloop) */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, workshare_type, "type of workshare region")
 INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, workshare_count, "number of iterations associated with workshare region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, workshare_chunks, "number of chunks or sections of the region dispatched to this thread")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, workshare_iterations, "number of iterations of the region dispatched to this thread")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, workshare_chunk_histogram, "chunks dispatched to this thread by size, as <min size>:<chunks> for each power-of-2 range of sizes")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, chunk_start, "first iteration of a dispatched chunk")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, chunk_iterations, "number of iterations in a dispatched chunk")
 
 /* Attributes relating to sync regions (barrier, taskgroup, taskwait) */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, sync_type, "type of synchronisation region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, sync_wait_intervals, "number of intervals the thread spent waiting in this region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, sync_task_time, "time (ns) spent executing tasks while waiting in this region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, sync_descendant_time, "time (ns) spent executing descendants of the waiting task in this taskwait or taskgroup region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, sync_unrelated_time, "time (ns) spent executing tasks which aren't descendants of the waiting task in this taskwait or taskgroup region")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, sync_idle_time, "time (ns) spent waiting in this region without executing a task")
 
 /* Attributes relating to task regions */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, parent_task_id, "unique ID of the parent task of this task")
@@ -68,13 +105,29 @@ INCLUDE_LABEL(event_type,  sync_end       )
 INCLUDE_LABEL(event_type,  task_create    )
 INCLUDE_LABEL(event_type,  task_schedule  )
 INCLUDE_LABEL(event_type,  task_enter     )
+INCLUDE_LABEL(event_type,  task_switch    )
+INCLUDE_LABEL(event_type,  task_complete  )
 INCLUDE_LABEL(event_type,  task_leave     )
 INCLUDE_LABEL(event_type,  master_begin   )
 INCLUDE_LABEL(event_type,  master_end     )
+INCLUDE_LABEL(event_type,  task_dependence)
+INCLUDE_LABEL(event_type,  mutex_release  )
+INCLUDE_LABEL(event_type,  workshare_chunk)
+
+/* Short nested regions which weren't written (see OTTER_ELIDE_SHORTER_THAN) */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, elided_regions, "number of short regions nested in this region which were elided")
+
+/* Call stack at parallel-begin or task-create (see OTTER_CALLSTACKS) */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT32, callstack_id, "id of the call stack recorded when the region was created")
 
 /* Result of call to sched_getcpu() */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_INT32, cpu, "cpu on which the encountering thread is running")
 
+/* Locality of a thread, written at thread-begin */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, thread_affinity, "CPUs on which the thread may run (sched_getaffinity), as a list of ranges")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_INT32, thread_place, "OpenMP place to which the thread is bound when it begins (-1 if none)")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_INT32, numa_node, "NUMA domain of the cpu on which the thread is running")
+
 /* Region begin or end event? */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, endpoint, "is this a region-enter or region-leave event")
 INCLUDE_LABEL(endpoint, enter   )
@@ -96,11 +149,59 @@ INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, task_is_final,      "task is final")
 INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, task_is_mergeable,  "task is mergeable")
 INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, task_is_merged,     "task is merged")
 
+/* Descendants of a task which were sampled out */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, untraced_descendants, "number of untraced descendant tasks so far")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, untraced_descendant_time, "total time (ns) spent executing untraced descendant tasks so far")
+
+/* Scheduling of a task, known once it first starts */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_start_latency, "time (ns) from the creation of this task until it first started")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_queued_time, "time (ns) this task spent ready but not started (tasks without dependences only)")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, task_is_stolen, "task first started on a thread other than the one which created it")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, task_is_remote, "task first started in a different NUMA domain from the one in which it was created")
+
+/* Dependence between two tasks, written as a parameter event whose value is
+   the predecessor task's ID */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, predecessor_task_id, "unique ID of the task on which this task depends")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, dependence_address, "address of the variable named in the depend clause (0 if reported by the runtime)")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, dependence_type, "type of dependence")
+INCLUDE_LABEL(dependence_type, in           )
+INCLUDE_LABEL(dependence_type, out          )
+INCLUDE_LABEL(dependence_type, inout        )
+INCLUDE_LABEL(dependence_type, mutexinoutset)
+INCLUDE_LABEL(dependence_type, inoutset     )
+INCLUDE_LABEL(dependence_type, source       )
+INCLUDE_LABEL(dependence_type, sink         )
+INCLUDE_LABEL(dependence_type, runtime      )
+
+/* Release of a lock or mutual-exclusion construct (see OTTER_LOCKS), written
+   as a parameter event whose value is the mutex's wait_id */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, wait_id, "runtime's identifier of the lock or construct waited for")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, codeptr_ra, "return address of the construct or runtime call")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, mutex_wait_time, "time (ns) spent waiting to acquire the mutex")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, mutex_hold_time, "time (ns) for which the mutex was held")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, mutex_kind, "kind of mutex")
+INCLUDE_LABEL(mutex_kind, lock          )
+INCLUDE_LABEL(mutex_kind, test_lock     )
+INCLUDE_LABEL(mutex_kind, nest_lock     )
+INCLUDE_LABEL(mutex_kind, test_nest_lock)
+INCLUDE_LABEL(mutex_kind, critical      )
+INCLUDE_LABEL(mutex_kind, atomic        )
+INCLUDE_LABEL(mutex_kind, ordered       )
+
 /* thread type */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, thread_type, "thread type")
 INCLUDE_LABEL(thread_type,  initial)
 INCLUDE_LABEL(thread_type,  worker )
 
+/* Tasks started by a thread, written at thread-end */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, thread_tasks_started, "number of tasks this thread started")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, thread_tasks_stolen, "number of those tasks created by another thread")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, thread_tasks_remote, "number of those tasks created in a different NUMA domain")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, thread_task_start_latency, "total time (ns) from creation to start of those tasks")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, thread_task_queued_time, "total time (ns) those tasks without dependences spent ready but not started")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, thread_cpu_migrations, "number of times this thread was seen on a different CPU than at its previous event")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, thread_task_latency_histogram, "tasks started by this thread by start latency, as <min ns>:<tasks> for each power-of-2 range of latencies")
+
 /* region type - parallel, workshare, sync, task */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, region_type, "region type")
 /* generic region types */
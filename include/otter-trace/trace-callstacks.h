@@ -0,0 +1,22 @@
+#if !defined(OTTER_TRACE_CALLSTACKS_H)
+#define OTTER_TRACE_CALLSTACKS_H
+
+#include <stdint.h>
+
+/* Deepest call stack recorded */
+#define CALLSTACK_MAX_FRAMES 8
+
+/* Id of an event with no call stack */
+#define CALLSTACK_NONE 0
+
+void trace_callstacks_initialise(void);
+
+/* Write the table of call stacks to path and free it */
+void trace_callstacks_finalise(const char *path);
+
+/* Capture the call stack of the application code which invoked the runtime at
+   codeptr_ra (frames inside Otter & the runtime are dropped) and return the id
+   of the identical entry in the process-wide stack table */
+uint32_t trace_callstack_capture(const void *codeptr_ra);
+
+#endif // OTTER_TRACE_CALLSTACKS_H
@@ -0,0 +1,42 @@
+#if !defined(OTTER_TRACE_COUNTERS_H)
+#define OTTER_TRACE_COUNTERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*  Performance counters selected with OTTER_COUNTERS, opened with
+    perf_event_open as one group per thread so that all counters are read
+    together. Counters which can't be opened (e.g. hardware counters when
+    /proc/sys/kernel/perf_event_paranoid forbids them) are dropped at
+    initialisation, and a thread which can't open its group records none.
+ */
+
+/* Maximum number of counters in a group */
+#define COUNTERS_MAX 8
+
+/* OTF2 metric class of the counters written at task & parallel region events */
+#define COUNTERS_METRIC 0
+
+/* A thread's group of open counters */
+typedef struct trace_counters_t trace_counters_t;
+
+/* Find which of the selected counters (otter_counter_t flags) can be opened
+   by the calling thread. Returns the number available */
+unsigned int trace_counters_initialise(unsigned int selected);
+
+/* The name, description & unit of the k-th available counter */
+void trace_counters_describe(unsigned int k, const char **name,
+    const char **description, const char **unit);
+
+/* Open the available counters for the calling thread. Returns NULL if none are
+   available or the group can't be opened */
+trace_counters_t *trace_counters_open(void);
+
+/* Read the counters' values in the order they are described, scaled up to
+   estimate their full values if the group was multiplexed. Returns false if
+   they couldn't be read or the group hasn't been scheduled yet */
+bool trace_counters_read(trace_counters_t *counters, uint64_t *values);
+
+void trace_counters_close(trace_counters_t *counters);
+
+#endif // OTTER_TRACE_COUNTERS_H
@@ -122,4 +122,37 @@
     status == ompt_task_switch        ?                                        \
         attr_label_ref[attr_prior_task_status_switch] : 0 )
 
+#define MUTEX_KIND_TO_STR_REF(kind)                                            \
+   (kind == ompt_mutex_lock           ? attr_label_ref[attr_mutex_kind_lock] : \
+    kind == ompt_mutex_test_lock      ?                                        \
+        attr_label_ref[attr_mutex_kind_test_lock] :                            \
+    kind == ompt_mutex_nest_lock      ?                                        \
+        attr_label_ref[attr_mutex_kind_nest_lock] :                            \
+    kind == ompt_mutex_test_nest_lock ?                                        \
+        attr_label_ref[attr_mutex_kind_test_nest_lock] :                       \
+    kind == ompt_mutex_critical       ?                                        \
+        attr_label_ref[attr_mutex_kind_critical] :                             \
+    kind == ompt_mutex_atomic         ?                                        \
+        attr_label_ref[attr_mutex_kind_atomic] :                               \
+    kind == ompt_mutex_ordered        ?                                        \
+        attr_label_ref[attr_mutex_kind_ordered] : 0 )
+
+#define DEPENDENCE_TYPE_TO_STR_REF(type)                                       \
+   (type == ompt_dependence_type_in            ?                               \
+        attr_label_ref[attr_dependence_type_in] :                              \
+    type == ompt_dependence_type_out           ?                               \
+        attr_label_ref[attr_dependence_type_out] :                             \
+    type == ompt_dependence_type_inout         ?                               \
+        attr_label_ref[attr_dependence_type_inout] :                           \
+    type == ompt_dependence_type_mutexinoutset ?                               \
+        attr_label_ref[attr_dependence_type_mutexinoutset] :                   \
+    type == ompt_dependence_type_inoutset      ?                               \
+        attr_label_ref[attr_dependence_type_inoutset] :                        \
+    type == ompt_dependence_type_source        ?                               \
+        attr_label_ref[attr_dependence_type_source] :                          \
+    type == ompt_dependence_type_sink          ?                               \
+        attr_label_ref[attr_dependence_type_sink] :                            \
+    type == TRACE_DEPENDENCE_RUNTIME           ?                               \
+        attr_label_ref[attr_dependence_type_runtime] : 0 )
+
 #endif // OTTER_TRACE_LOOKUP_MACROS_H
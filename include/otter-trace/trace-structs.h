@@ -10,6 +10,7 @@
 #include <otter-datatypes/queue.h>
 #include <otter-datatypes/stack.h>
 #include <otter-trace/trace.h>
+#include <otter-trace/trace-counters.h>
 
 /* Forward definitions */
 typedef struct trace_parallel_region_attr_t trace_parallel_region_attr_t;
@@ -25,6 +26,21 @@ struct trace_parallel_region_attr_t {
     unique_id_t     master_thread;
     bool            is_league;
     unsigned int    requested_parallelism;
+    uint64_t        skipped_instances;  // sampled out since last traced
+    uint64_t        skipped_time;       // ns spent in those instances
+    uint64_t        throttled_tasks;
+    uint64_t        throttled_task_time;
+    uint64_t        barriers;           // completed by the whole team
+    uint64_t        barrier_skew;       // ns from first to last arrival (sum)
+    uint64_t        max_barrier_skew;   // ns
+    uint64_t        barrier_wait;       // ns threads waited for the last
+    uint64_t        category_tasks[NUM_TASK_CATEGORIES];
+    uint64_t        category_time[NUM_TASK_CATEGORIES];     // ns
+    trace_task_production_t production; // set when the region ends
+    OTF2_CommRef    team;               // members ranked by implicit task index
+    uint64_t       *members;            // location refs
+    unsigned int    team_size;
+    unsigned int    peak_threads;       // OpenMP threads in any team (max)
     unsigned int    ref_count;
     unsigned int    enter_count;
     pthread_mutex_t lock_rgn;
@@ -35,6 +51,9 @@ struct trace_parallel_region_attr_t {
 struct trace_wshare_region_attr_t {
     ompt_work_t     type;
     uint64_t        count;
+    uint64_t        chunks;             // dispatched to this thread
+    uint64_t        iterations;         // in those chunks
+    uint64_t        chunk_histogram[LOOP_CHUNK_BINS];
 };
 
 /* Attributes of a master region */
@@ -46,6 +65,13 @@ struct trace_master_region_attr_t {
 struct trace_sync_region_attr_t {
     ompt_sync_region_t  type;
     unique_id_t         encountering_task_id;
+    uint64_t            wait_intervals;
+    uint64_t            wait_begin;         // timestamp, 0 if not waiting
+    uint64_t            wait_time;          // ns
+    uint64_t            task_begin;         // timestamp of current task-enter
+    uint64_t            task_time;          // ns executing tasks while waiting
+    bool                task_descendant;    // of the waiting task (current)
+    uint64_t            descendant_time;    // ns of task_time
 };
 
 /* Attributes of a task region */
@@ -57,6 +83,17 @@ struct trace_task_region_attr_t {
     unique_id_t         parent_id;
     ompt_task_flag_t    parent_type;
     ompt_task_status_t  task_status;
+    uint64_t            untraced_descendants;
+    uint64_t            untraced_descendant_time;
+    OTF2_CommRef        team;               // identify the task in OTF2 task
+    uint32_t            creating_thread;    // events by its creating thread's
+    uint32_t            generation;         // rank in team & a generation number
+    bool                started;            // scheduling attributes are set
+    bool                stolen;
+    bool                remote;             // started in another NUMA domain
+    int                 creating_numa;      // -1 if unknown
+    uint64_t            start_latency;      // ns
+    uint64_t            queued_time;        // ns
 };
 
 /* Store values needed to register region definition (tasks, parallel regions, 
@@ -67,6 +104,9 @@ struct trace_region_def_t {
     OTF2_AttributeList  *attributes;
     trace_region_type_t  type;
     unique_id_t          encountering_task_id;
+    uint64_t             elided_regions;    // short nested regions not written
+    const void          *codeptr_ra;        // resolved when definition written
+    uint32_t             callstack_id;      // see trace-callstacks.h
     union {
         trace_parallel_region_attr_t    parallel;
         trace_wshare_region_attr_t      wshare;
@@ -90,6 +130,19 @@ struct trace_location_def_t {
     OTF2_AttributeList     *attributes;
     OTF2_EvtWriter         *evt_writer;
     OTF2_DefWriter         *def_writer;
+    trace_region_def_t     *pending_enter;      // enter event not yet written
+    uint64_t                pending_enter_time;
+    uint64_t                tasks_started;
+    uint64_t                tasks_stolen;
+    uint64_t                tasks_remote;
+    uint64_t                task_start_latency; // ns
+    uint64_t                task_queued_time;   // ns
+    uint64_t                task_latency_histogram[TASK_LATENCY_BINS];
+    trace_counters_t       *counters;           // NULL unless OTTER_COUNTERS
+    int                     cpu;                // at the last event, or -1
+    int                     place;              // at thread-begin, or -1
+    OTF2_StringRef          affinity;           // CPU list at thread-begin
+    uint64_t                migrations;         // CPU changes between events
 };
 
 /* Create new location */
@@ -107,25 +160,32 @@ trace_new_parallel_region(
     unique_id_t    master,
     unique_id_t    encountering_task_id,
     int            flags,
-    unsigned int   requested_parallelism);
+    unsigned int   requested_parallelism,
+    uint64_t       skipped_instances,
+    uint64_t       skipped_time,
+    const void    *codeptr_ra,
+    uint32_t       callstack_id);
 
 trace_region_def_t *
 trace_new_workshare_region(
     trace_location_def_t *loc,
     ompt_work_t           wstype,
     uint64_t              count,
-    unique_id_t           encountering_task_id);
+    unique_id_t           encountering_task_id,
+    const void           *codeptr_ra);
 
 trace_region_def_t *
 trace_new_master_region(
     trace_location_def_t *loc,
-    unique_id_t           encountering_task_id);
+    unique_id_t           encountering_task_id,
+    const void           *codeptr_ra);
 
 trace_region_def_t *
 trace_new_sync_region(
     trace_location_def_t *loc,
     ompt_sync_region_t    stype,
-    unique_id_t           encountering_task_id);
+    unique_id_t           encountering_task_id,
+    const void           *codeptr_ra);
 
 trace_region_def_t *
 trace_new_task_region(
@@ -133,7 +193,54 @@ trace_new_task_region(
     trace_region_def_t   *parent_task_region,
     unique_id_t           task_id,
     ompt_task_flag_t      flags,
-    int                   has_dependences);
+    int                   has_dependences,
+    const void           *codeptr_ra,
+    uint32_t              callstack_id);
+
+/* Count untraced descendant tasks & their execution time into a task region */
+void trace_add_untraced_descendants(
+    trace_region_def_t *task_rgn, uint64_t count, uint64_t time);
+
+/* Count throttled tasks & their execution time into a parallel region */
+void trace_add_throttled_tasks(
+    trace_region_def_t *parallel_rgn, uint64_t count, uint64_t time);
+
+/* Count explicit tasks of a category created in a parallel region, or the
+   time spent executing them */
+void trace_add_task_category(trace_region_def_t *parallel_rgn,
+    trace_task_category_t category, uint64_t count, uint64_t time);
+
+/* Count a barrier of a parallel region once the whole team has arrived: the
+   time from the first to the last arrival, and the total time the threads
+   waited for the last to arrive */
+void trace_add_barrier_arrivals(
+    trace_region_def_t *parallel_rgn, uint64_t skew, uint64_t wait);
+
+/* Set how a parallel region's tasks were produced & consumed, once the team
+   has passed the region's final barrier */
+void trace_set_task_production(trace_region_def_t *parallel_rgn,
+    const trace_task_production_t *production);
+
+/* Record the start of a task on a thread: the time since it was created and
+   the part of that for which it was ready, and whether it was created by
+   another thread. Sets the scheduling attributes of task_rgn unless NULL,
+   including whether it started in a different NUMA domain from its creation */
+void trace_add_task_start(trace_location_def_t *loc,
+    trace_region_def_t *task_rgn, uint64_t latency, uint64_t queued,
+    bool stolen);
+
+/* A thread joined a parallel region's team as the member with rank index,
+   when live_threads OpenMP threads were executing in any team */
+void trace_add_team_member(trace_region_def_t *parallel_rgn,
+    unsigned int index, unsigned int team_size, unsigned int live_threads,
+    trace_location_def_t *loc);
+
+/* Set the OTF2 identity of a task: a task created by the member with rank
+   creating_thread in the team of parallel_rgn (NULL for the initial team), with
+   a generation number unique to the creating thread */
+void trace_set_task_identity(trace_region_def_t *task_rgn,
+    trace_region_def_t *parallel_rgn, uint32_t creating_thread,
+    uint32_t generation);
 
 /* Destroy location/region */
 void trace_destroy_location(trace_location_def_t *loc);
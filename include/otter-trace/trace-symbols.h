@@ -0,0 +1,36 @@
+#if !defined(OTTER_TRACE_SYMBOLS_H)
+#define OTTER_TRACE_SYMBOLS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Source information for a code address such as a construct's codeptr_ra.
+   Fields which couldn't be resolved are NULL or 0 */
+typedef struct symbol_info_t {
+    const void   *addr;
+    const char   *object;       // path of the executable or shared object
+    const char   *function;     // (mangled) name of the enclosing function
+    const char   *file;         // source file, only if resolved with a line
+    unsigned int  line;
+    bool          line_resolved;
+} symbol_info_t;
+
+void symbols_initialise(void);
+void symbols_finalise(void);
+
+/* Lines are looked up by an addr2line process kept running for each object.
+   So that no process is started inside an OpenMP callback, these are only
+   started for the executable (if its lines are needed while tracing), and for
+   any object once tracing is finished */
+void symbols_resolve_executable(void);
+void symbols_resolve_all(void);
+
+/* Resolve an address once and cache the result. Looking up source file & line
+   needs DWARF debug info and is only done if need_line is set, as it is much
+   slower. Until a resolver may be started for the address's object, its line
+   is left unresolved and looked up again by a later call.
+   function & file may be published by another thread's lookup, so read them
+   with an atomic load if the symbol is shared while tracing */
+const symbol_info_t *symbols_lookup(const void *addr, bool need_line);
+
+#endif // OTTER_TRACE_SYMBOLS_H
@@ -0,0 +1,32 @@
+#if !defined(OTTER_TRACE_TOPOLOGY_H)
+#define OTTER_TRACE_TOPOLOGY_H
+
+#include <stddef.h>
+
+/*  Hardware topology of the online CPUs, read from sysfs when tracing is
+    initialised: the NUMA domain, socket (physical package) and core of each
+    hardware thread. Anything which can't be read is reported as domain,
+    socket or core 0.
+ */
+
+typedef struct trace_cpu_topology_t {
+    int     cpu;
+    int     numa;
+    int     package;
+    int     core;
+} trace_cpu_topology_t;
+
+void trace_topology_initialise(void);
+void trace_topology_finalise(void);
+
+/* The online CPUs, ordered by NUMA domain, socket, core and CPU */
+const trace_cpu_topology_t *trace_topology_cpus(size_t *n_cpus);
+
+/* NUMA domain of a CPU, or -1 if unknown */
+int trace_topology_numa_node(int cpu);
+
+/* Write the calling thread's affinity mask as a list of CPU ranges, e.g.
+   "0-3,8" */
+void trace_topology_affinity(char *buf, size_t size);
+
+#endif // OTTER_TRACE_TOPOLOGY_H
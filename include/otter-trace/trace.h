@@ -10,6 +10,23 @@
 
 #define DEFAULT_LOCATION_GRP 0 // OTF2_UNDEFINED_LOCATION_GROUP
 #define DEFAULT_SYSTEM_TREE  0
+#define TASK_DEPENDENCE_PARAMETER 0 // value is the predecessor task's ID
+#define MUTEX_RELEASE_PARAMETER   1 // value is the mutex's wait_id
+#define LOOP_CHUNK_PARAMETER      2 // value is the chunk's first iteration
+
+/* Thread team of the initial task, i.e. the implicit parallel region */
+#define INITIAL_TEAM_COMM 0
+
+/* Type of a dependence edge reported by the runtime, which gives neither the
+   address nor the type of the dependence. Not an OMPT dependence type */
+#define TRACE_DEPENDENCE_RUNTIME ((ompt_dependence_type_t) 0)
+
+/* Bin k of a workshare region's chunk histogram counts chunks of [2^k, 2^(k+1))
+   iterations. The last bin also counts any larger chunks */
+#define LOOP_CHUNK_BINS 16
+
+/* Bin k of a task latency histogram counts latencies of [2^k, 2^(k+1)) ns */
+#define TASK_LATENCY_BINS 32
 #define DEFAULT_NAME_BUF_SZ  256
 
 #define CHECK_OTF2_ERROR_CODE(r)                                               \
@@ -27,6 +44,8 @@
 #define get_unique_str_ref() (get_unique_uint32_ref(trace_string))
 #define get_unique_loc_ref() (get_unique_uint64_ref(trace_location))
 #define get_other_ref()      (get_unique_uint64_ref(trace_other))
+#define get_unique_comm_ref() (get_unique_uint32_ref(trace_comm))
+#define get_unique_grp_ref() (get_unique_uint32_ref(trace_group))
 
 /* Different kinds of unique IDs */
 typedef enum trace_ref_type_t {
@@ -34,6 +53,8 @@ typedef enum trace_ref_type_t {
     trace_string,
     trace_location,
     trace_other,
+    trace_comm,
+    trace_group,
     NUM_REF_TYPES // <- MUST BE LAST ENUM ITEM
 } trace_ref_type_t;
 
@@ -53,6 +74,39 @@ typedef enum {
     trace_region_master
 } trace_region_type_t;
 
+/* Kinds of marker written to the archive's marker file */
+typedef enum {
+    trace_marker_activation,
+    trace_marker_throttling,
+    trace_marker_preemption,
+    trace_marker_migration,
+    trace_marker_oversubscription,
+    NUM_MARKER_TYPES // <- MUST BE LAST ENUM ITEM
+} trace_marker_type_t;
+
+/* How an explicit task was executed, from the flags with which it was created.
+   A task is counted in the first of merged, final & undeferred which applies */
+typedef enum {
+    trace_task_deferred,
+    trace_task_undeferred,
+    trace_task_final,
+    trace_task_merged,
+    NUM_TASK_CATEGORIES // <- MUST BE LAST ENUM ITEM
+} trace_task_category_t;
+
+/* How a parallel region's tasks were produced and consumed. The top producer
+   is the member of the team which created the most tasks */
+typedef struct trace_task_production_t {
+    unsigned int    producers;          // members which created tasks
+    uint64_t        tasks;              // created by the whole team
+    uint64_t        top_producer_tasks;
+    uint64_t        producer_time;      // ns top producer spent in callbacks
+    uint64_t        creation_rate;      // tasks/s by the top producer
+    uint64_t        consumption_rate;   // tasks/s the team could execute
+    uint64_t        starved_time;       // ns idle until a task became ready
+    bool            bottleneck;
+} trace_task_production_t;
+
 /* Defined in trace-structs.h */
 typedef struct trace_region_def_t trace_region_def_t;
 typedef struct trace_location_def_t trace_location_def_t;
@@ -61,6 +115,9 @@ typedef struct trace_location_def_t trace_location_def_t;
 uint64_t get_unique_uint64_ref(trace_ref_type_t ref_type);
 uint32_t get_unique_uint32_ref(trace_ref_type_t ref_type);
 
+/* CLOCK_MONOTONIC time in ns, as recorded for each event */
+uint64_t get_timestamp(void);
+
 /* interface function prototypes */
 bool trace_initialise_archive(otter_opt_t *opt);
 bool trace_finalise_archive(void);
@@ -72,8 +129,21 @@ void trace_event_enter(trace_location_def_t *self, trace_region_def_t *region);
 void trace_event_leave(trace_location_def_t *self);
 void trace_event_task_create(trace_location_def_t *self, trace_region_def_t *created_task);
 void trace_event_task_schedule(trace_location_def_t *self, trace_region_def_t *prior_task, ompt_task_status_t prior_status);
-// void trace_event_task_switch(trace_location_def_t *self);
-// void trace_event_task_complete(trace_location_def_t *self);
+void trace_event_task_switch(trace_location_def_t *self, trace_region_def_t *next_task);
+void trace_event_task_complete(trace_location_def_t *self, trace_region_def_t *completed_task);
+void trace_event_marker(trace_location_def_t *self, trace_marker_type_t type, const char *text);
+void trace_event_mutex_release(trace_location_def_t *self, ompt_mutex_t kind, ompt_wait_id_t wait_id, const void *codeptr_ra, uint64_t wait_time, uint64_t hold_time);
+void trace_event_task_dependence(trace_location_def_t *self, unique_id_t task_id, unique_id_t predecessor_id, uint64_t address, ompt_dependence_type_t type);
+
+/* Account for time within the sync region at the top of the region stack */
+void trace_sync_region_wait(trace_location_def_t *self, ompt_scope_endpoint_t endpoint);
+void trace_sync_region_add_task_time(trace_location_def_t *self, uint64_t time, bool descendant);
+void trace_sync_region_set_descendant(trace_location_def_t *self, bool descendant);
+
+/* Count a chunk of iterations dispatched to the thread in the workshare region
+   at the top of the region stack, optionally writing an event for it */
+void trace_workshare_dispatch(trace_location_def_t *self, uint64_t start, uint64_t iterations, bool write_event);
+
 
 /* write definitions to the global def writer */
 void trace_write_location_definition(trace_location_def_t *loc);
@@ -13,6 +13,50 @@ export OTTER_TRACE_PATH="scratch/trace"
 # OTF2 trace name
 export OTTER_TRACE_NAME="archive"
 
+# If defined, only trace after/for a given time (e.g. 120s, 500ms)
+# export OTTER_START_AFTER=120s
+# export OTTER_DURATION=30s
+
+# If defined, trace the first K then 1 in N instances of each parallel region
+# export OTTER_SAMPLE_PARALLEL_FIRST=5
+# export OTTER_SAMPLE_PARALLEL=100
+
+# If defined, trace only a fraction of task subtrees or tasks to a given depth
+# export OTTER_SAMPLE_TASKS=0.1
+# export OTTER_TASK_MAX_DEPTH=4
+
+# If defined, only trace these classes of event (e.g. exclude barriers)
+# export OTTER_EVENTS=-barrier
+
+# If defined, only trace constructs selected by this filter file
+# export OTTER_FILTER=otter-filter.txt
+
+# If defined, throttle task constructs creating many short tasks
+# export OTTER_THROTTLE_RATE=10000
+# export OTTER_THROTTLE_DURATION=10us
+
+# If defined, don't write workshare/sync/master regions shorter than this
+# export OTTER_ELIDE_SHORTER_THAN=1us
+
+# If defined, record the call stack of 1 in N parallel regions & tasks
+# export OTTER_CALLSTACKS=10
+
+# If defined, change how loop chunks are recorded (off|aggregate|chunks)
+# export OTTER_DISPATCH=chunks
+
+# If defined, record lock & critical-section contention (aggregate|trace)
+# export OTTER_LOCKS=aggregate
+
+# If defined, record these performance counters (e.g. software,instructions)
+# export OTTER_COUNTERS=software
+
+# If defined, detect preemption & CPU migration of threads
+# export OTTER_NOISE=1
+
+# If defined, report tasks shorter than this multiple of the task creation cost
+# and recommend task cutoffs at exit
+# export OTTER_GRANULARITY=10
+
 printf "%-25s %s\n" "OTTER_TRACE_PATH:" $OTTER_TRACE_PATH
 printf "%-25s %s\n" "OTTER_TRACE_NAME:" $OTTER_TRACE_NAME
 
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+
+#include <macros/debug.h>
+#include <otter-common.h>
+#include <otter-core/otter-activation.h>
+#include <otter-trace/trace.h>
+
+static void on_sigusr2(int signum);
+
+bool tracing_active = true;
+
+/* Set by SIGUSR2, consumed by activation_update */
+static volatile sig_atomic_t toggle_requested = 0;
+
+/* Activation window, measured from tool start-up */
+static uint64_t window_open  = 0;
+static uint64_t window_close = 0;
+static bool     window_opened = false;
+static bool     window_closed = false;
+
+void
+activation_setup(otter_opt_t *opt)
+{
+    uint64_t now = get_timestamp();
+
+    window_open  = now + opt->start_after;
+    window_close = opt->duration ? window_open + opt->duration : 0;
+
+    /* Tracing starts inactive if a delay was requested */
+    tracing_active = (opt->start_after == 0);
+    window_opened = tracing_active;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_sigusr2;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGUSR2, &action, NULL) != 0)
+    {
+        LOG_ERROR("failed to install SIGUSR2 handler: %s", strerror(errno));
+        errno = 0;
+    }
+
+    LOG_INFO("tracing %s at start-up", tracing_active ? "active" : "inactive");
+    return;
+}
+
+void
+activation_update(void)
+{
+    bool active = tracing_active;
+    const char *reason = NULL;
+    uint64_t now = get_timestamp();
+
+    if (!window_opened && now >= window_open)
+    {
+        window_opened = true;
+        active = true;
+        reason = "activation window opened";
+    }
+
+    if (window_opened && !window_closed && window_close && now >= window_close)
+    {
+        window_closed = true;
+        active = false;
+        reason = "activation window closed";
+    }
+
+    if (toggle_requested)
+    {
+        toggle_requested = 0;
+        active = !active;
+        reason = "SIGUSR2 received";
+    }
+
+    if (active == tracing_active) return;
+
+    tracing_active = active;
+
+    char text[DEFAULT_NAME_BUF_SZ+1] = {0};
+    snprintf(text, DEFAULT_NAME_BUF_SZ, "tracing %s (%s)",
+        active ? "activated" : "deactivated", reason);
+    trace_event_marker(NULL, trace_marker_activation, text);
+
+    LOG_INFO("%s", text);
+    return;
+}
+
+static void
+on_sigusr2(int signum)
+{
+    toggle_requested = 1;
+}
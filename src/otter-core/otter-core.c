@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <unistd.h>         // gethostname
 #include <sys/time.h>       // getrusage
@@ -17,15 +18,117 @@
 #include <otter-core/otter-structs.h>
 #include <otter-core/otter-entry.h>
 #include <otter-core/otter-environment-variables.h>
+#include <otter-core/otter-activation.h>
+#include <otter-core/otter-filter.h>
+#include <otter-core/otter-locks.h>
+#include <otter-core/otter-noise.h>
+#include <otter-core/otter-granularity.h>
+#include <otter-trace/trace-symbols.h>
+#include <otter-trace/trace-callstacks.h>
 #include <otter-trace/trace.h>
 #include <otter-trace/trace-structs.h>
+#include <otter-trace/trace-topology.h>
+#include <otter-datatypes/histogram.h>
 
 /* Static function prototypes */
 static void print_resource_usage(void);
+static uint64_t parse_duration(const char *str);
+static void update_activation_state(
+    thread_data_t *thread_data, task_data_t *task_data);
+static unsigned int parse_count(const char *name);
+static bool sample_parallel_region(construct_data_t *construct);
+static void print_sampling_summary(void);
+static double parse_fraction(const char *name);
+static unsigned int parse_event_classes(const char *str);
+static void record_task_completion(
+    thread_data_t *thread_data, task_data_t *task_data);
+static void print_throttling_summary(void);
+static void record_task_start(
+    thread_data_t *thread_data, task_data_t *task_data);
+static void print_scheduling_summary(void);
+static void print_parallelism_summary(void);
+static uint32_t sample_callstack(
+    thread_data_t *thread_data, const void *codeptr_ra);
+static bool sample_task_subtree(
+    thread_data_t *thread_data, task_data_t *parent_task_data);
+static unsigned int parse_locks_mode(const char *str);
+static bool sync_region_included(ompt_sync_region_t kind);
+static unsigned int parse_dispatch_mode(const char *str);
+static unsigned int parse_counters(const char *str);
+static void sample_noise(thread_data_t *thread_data);
+static unsigned int update_live_threads(
+    thread_data_t *thread_data, ompt_scope_endpoint_t endpoint);
+static void record_team_member(parallel_data_t *parallel_data,
+    unsigned int index, unsigned int actual_parallelism,
+    unsigned int live_threads);
+static void atomic_max(unsigned int *dest, unsigned int value);
+static void record_barrier_arrival(task_data_t *task_data,
+    const void *codeptr_ra);
+static void print_barrier_summary(void);
+static trace_task_category_t task_category(int flags);
+static void record_task_category_time(task_data_t *task_data);
+static void print_task_category_summary(void);
+static bool waiting_for_descendant(
+    thread_data_t *thread_data, task_data_t *task_data);
+static int compare_barrier_skew(const void *a, const void *b);
+static void release_dependence_map(task_data_t *task_data);
+static task_producer_t *task_producer(
+    thread_data_t *thread_data, parallel_data_t *parallel_data);
+static void begin_idle(thread_data_t *thread_data, task_data_t *task_data);
+static void end_idle(thread_data_t *thread_data, bool starved);
+static void record_task_production(parallel_data_t *parallel_data);
+static void print_producer_summary(void);
+
+/* Dispatch of loop chunks was added in OpenMP 5.2, so may be missing from the
+   OMPT header */
+#define OTTER_DISPATCH_WS_LOOP_CHUNK    3
+#define OTTER_DISPATCH_TASKLOOP_CHUNK   4
+#define OTTER_DISPATCH_DISTRIBUTE_CHUNK 5
+typedef struct otter_dispatch_chunk_t {
+    uint64_t start;
+    uint64_t iterations;
+} otter_dispatch_chunk_t;
+
+/* Constructs encountered by a task are traced if the task itself is traced.
+   Outside of any parallel region, those encountered by the initial task also
+   follow the activation state (see otter-activation.h) */
+#define TASK_ENCOUNTERS_TRACED(task_data)                                      \
+    ((task_data) != NULL && (task_data)->region != NULL                        \
+        && ((task_data)->type != ompt_task_initial || tracing_active))
+
+/* A region is traced if its encountering task is traced, it isn't nested in an
+   untraced region and its construct isn't filtered out. Nested regions must
+   follow an untraced region so that begin & end events stay paired */
+#define REGION_BEGIN_TRACED(task_data, codeptr_ra)                             \
+    (TASK_ENCOUNTERS_TRACED(task_data) && (task_data)->untraced_depth == 0     \
+        && filter_include(codeptr_ra))
+
+/* Task lineages are needed to tell whether a task executed in a taskwait or
+   taskgroup region descends from the waiting task, and to add completed
+   descendants' time to their ancestors for OTTER_GRANULARITY */
+#define LINEAGE_NEEDED(opt)                                                    \
+    (((opt)->events & otter_event_sync) || (opt)->granularity > 0)
 
 /* OMPT entrypoint signatures */
 ompt_get_thread_data_t     get_thread_data;
 ompt_get_parallel_info_t   get_parallel_info;
+ompt_get_place_num_t       get_place_num;
+
+/* Options read in tool_setup */
+static otter_opt_t *tool_opt = NULL;
+
+/* Threads between their thread-begin and thread-end events */
+static unsigned int running_threads = 0;
+
+/* Dependences whose address couldn't be added to a full dependence map */
+static uint64_t dependences_dropped = 0;
+
+/* OpenMP threads executing an implicit task of any team, and the time for which
+   there were more of them than online CPUs */
+static unsigned int live_threads = 0;
+static unsigned int peak_live_threads = 0;
+static uint64_t oversubscribed_since = 0;
+static uint64_t oversubscribed_time = 0;
 
 /* Register the tool's callbacks with otter-entry.c */
 otter_opt_t *
@@ -33,24 +136,10 @@ tool_setup(
     tool_callbacks_t        *callbacks,
     ompt_function_lookup_t  lookup)
 {
-    include_callback(callbacks, ompt_callback_parallel_begin);
-    include_callback(callbacks, ompt_callback_parallel_end);
-    include_callback(callbacks, ompt_callback_thread_begin);
-    include_callback(callbacks, ompt_callback_thread_end);
-    include_callback(callbacks, ompt_callback_task_create);
-    include_callback(callbacks, ompt_callback_task_schedule);
-    include_callback(callbacks, ompt_callback_implicit_task);
-    include_callback(callbacks, ompt_callback_work);
-    include_callback(callbacks, ompt_callback_sync_region);
-    #if defined(USE_OMPT_MASKED)
-    include_callback(callbacks, ompt_callback_masked);
-    #else
-    include_callback(callbacks, ompt_callback_master);
-    #endif
-
     get_thread_data = (ompt_get_thread_data_t) lookup("ompt_get_thread_data");
     get_parallel_info = 
         (ompt_get_parallel_info_t) lookup("ompt_get_parallel_info");
+    get_place_num = (ompt_get_place_num_t) lookup("ompt_get_place_num");
 
     static char host[HOST_NAME_MAX+1] = {0};
     gethostname(host, HOST_NAME_MAX);
@@ -61,13 +150,50 @@ tool_setup(
         .tracename        = NULL,
         .tracepath        = NULL,
         .archive_name     = NULL,
-        .append_hostname  = false
+        .append_hostname  = false,
+        .start_after      = 0,
+        .duration         = 0,
+        .sample_parallel  = 0,
+        .sample_parallel_first = 0,
+        .sample_tasks     = 1.0,
+        .task_max_depth   = 0,
+        .events           = otter_event_all,
+        .throttle_rate    = 0,
+        .throttle_duration = DEFAULT_THROTTLE_DURATION,
+        .elide_threshold  = 0,
+        .callstacks       = 0,
+        .locks            = otter_locks_off,
+        .dispatch         = otter_dispatch_aggregate,
+        .counters         = 0,
+        .noise            = false,
+        .granularity      = 0
     };
 
     opt.hostname = host;
     opt.tracename = getenv(ENV_VAR_TRACE_OUTPUT);
     opt.tracepath = getenv(ENV_VAR_TRACE_PATH);
     opt.append_hostname = getenv(ENV_VAR_APPEND_HOST) == NULL ? false : true;
+    opt.start_after = parse_duration(getenv(ENV_VAR_START_AFTER));
+    opt.duration = parse_duration(getenv(ENV_VAR_DURATION));
+    opt.sample_parallel = parse_count(ENV_VAR_SAMPLE_PARALLEL);
+    opt.sample_parallel_first = parse_count(ENV_VAR_SAMPLE_FIRST);
+    opt.sample_tasks = parse_fraction(ENV_VAR_SAMPLE_TASKS);
+    opt.task_max_depth = parse_count(ENV_VAR_TASK_MAX_DEPTH);
+    opt.events = parse_event_classes(getenv(ENV_VAR_EVENTS));
+    opt.throttle_rate = parse_count(ENV_VAR_THROTTLE_RATE);
+    if (getenv(ENV_VAR_THROTTLE_DURATION) != NULL)
+        opt.throttle_duration = parse_duration(getenv(ENV_VAR_THROTTLE_DURATION));
+    opt.elide_threshold = parse_duration(getenv(ENV_VAR_ELIDE_THRESHOLD));
+    opt.callstacks = parse_count(ENV_VAR_CALLSTACKS);
+    opt.locks = parse_locks_mode(getenv(ENV_VAR_LOCKS));
+    opt.dispatch = parse_dispatch_mode(getenv(ENV_VAR_DISPATCH));
+    opt.counters = parse_counters(getenv(ENV_VAR_COUNTERS));
+    opt.noise = getenv(ENV_VAR_NOISE) == NULL ? false : true;
+    if (getenv(ENV_VAR_GRANULARITY) != NULL)
+    {
+        opt.granularity = parse_count(ENV_VAR_GRANULARITY);
+        if (opt.granularity == 0) opt.granularity = DEFAULT_GRANULARITY;
+    }
 
     /* Apply defaults if variables not provided */
     if(opt.tracename == NULL) opt.tracename = DEFAULT_OTF2_TRACE_OUTPUT;
@@ -78,9 +204,81 @@ tool_setup(
     LOG_INFO("%-30s %s", ENV_VAR_TRACE_PATH,   opt.tracepath);
     LOG_INFO("%-30s %s", ENV_VAR_TRACE_OUTPUT, opt.tracename);
     LOG_INFO("%-30s %s", ENV_VAR_APPEND_HOST,  opt.append_hostname?"Yes":"No");
+    LOG_INFO("%-30s %lu ns", ENV_VAR_START_AFTER, opt.start_after);
+    LOG_INFO("%-30s %lu ns", ENV_VAR_DURATION,    opt.duration);
+    LOG_INFO("%-30s %u", ENV_VAR_SAMPLE_PARALLEL, opt.sample_parallel);
+    LOG_INFO("%-30s %u", ENV_VAR_SAMPLE_FIRST,    opt.sample_parallel_first);
+    LOG_INFO("%-30s %.3f", ENV_VAR_SAMPLE_TASKS,  opt.sample_tasks);
+    LOG_INFO("%-30s %u", ENV_VAR_TASK_MAX_DEPTH,  opt.task_max_depth);
+    LOG_INFO("%-30s 0x%02x", ENV_VAR_EVENTS,      opt.events);
+    LOG_INFO("%-30s %u", ENV_VAR_THROTTLE_RATE,   opt.throttle_rate);
+    LOG_INFO("%-30s %lu ns", ENV_VAR_THROTTLE_DURATION, opt.throttle_duration);
+    LOG_INFO("%-30s %lu ns", ENV_VAR_ELIDE_THRESHOLD, opt.elide_threshold);
+    LOG_INFO("%-30s %u", ENV_VAR_CALLSTACKS, opt.callstacks);
+    LOG_INFO("%-30s %u", ENV_VAR_LOCKS, opt.locks);
+    LOG_INFO("%-30s %u", ENV_VAR_DISPATCH, opt.dispatch);
+    LOG_INFO("%-30s 0x%02x", ENV_VAR_COUNTERS, opt.counters);
+    LOG_INFO("%-30s %s", ENV_VAR_NOISE, opt.noise ? "Yes" : "No");
+    LOG_INFO("%-30s %u", ENV_VAR_GRANULARITY, opt.granularity);
+    LOG_INFO("%-30s %s", ENV_VAR_FILTER,
+        getenv(ENV_VAR_FILTER) ? getenv(ENV_VAR_FILTER) : "");
+
+    /* Only register the callbacks for the selected classes of event so the
+       runtime never dispatches the others. Each filter applies equally to the
+       begin & end of a region, so region stacks remain well-nested */
+    include_callback(callbacks, ompt_callback_parallel_begin);
+    include_callback(callbacks, ompt_callback_parallel_end);
+    include_callback(callbacks, ompt_callback_thread_begin);
+    include_callback(callbacks, ompt_callback_thread_end);
+    include_callback(callbacks, ompt_callback_implicit_task);
+    if (opt.events & otter_event_tasks)
+    {
+        include_callback(callbacks, ompt_callback_task_create);
+        include_callback(callbacks, ompt_callback_task_schedule);
+        include_callback(callbacks, ompt_callback_dependences);
+        include_callback(callbacks, ompt_callback_task_dependence);
+    }
+    if (opt.events & otter_event_workshare)
+    {
+        include_callback(callbacks, ompt_callback_work);
+        if (opt.dispatch != otter_dispatch_off)
+            include_callback(callbacks, ompt_callback_dispatch);
+    }
+    if (opt.events & (otter_event_sync | otter_event_barrier))
+    {
+        include_callback(callbacks, ompt_callback_sync_region);
+        include_callback(callbacks, ompt_callback_sync_region_wait);
+    }
+    if (opt.events & otter_event_master)
+    {
+        #if defined(USE_OMPT_MASKED)
+        include_callback(callbacks, ompt_callback_masked);
+        #else
+        include_callback(callbacks, ompt_callback_master);
+        #endif
+    }
+    if (opt.locks != otter_locks_off)
+    {
+        include_callback(callbacks, ompt_callback_mutex_acquire);
+        include_callback(callbacks, ompt_callback_mutex_acquired);
+        include_callback(callbacks, ompt_callback_mutex_released);
+        include_callback(callbacks, ompt_callback_lock_init);
+        include_callback(callbacks, ompt_callback_lock_destroy);
+    }
 
+    tool_opt = &opt;
+    constructs_initialise();
+    locks_initialise();
+    granularity_initialise(opt.granularity);
+    symbols_initialise();
+    if (!filter_initialise(getenv(ENV_VAR_FILTER)))
+        LOG_ERROR("errors in filter file %s", getenv(ENV_VAR_FILTER));
     trace_initialise_archive(&opt);
 
+    /* Markers are written when tracing is (de)activated, so start the
+       activation window once the archive is open */
+    activation_setup(&opt);
+
     return &opt;
 }
 
@@ -89,6 +287,24 @@ tool_finalise(ompt_data_t *tool_data)
 {
     trace_finalise_archive();
     print_resource_usage();
+    print_sampling_summary();
+    print_throttling_summary();
+    print_scheduling_summary();
+    print_parallelism_summary();
+    print_task_category_summary();
+    if (tool_opt->granularity > 0) granularity_print_summary();
+    print_barrier_summary();
+    print_producer_summary();
+    LOG_WARN_IF((dependences_dropped > 0), "%lu task dependences weren't "
+        "recorded as their parent's dependence map was full",
+        dependences_dropped);
+    if (tool_opt->locks != otter_locks_off) locks_print_summary();
+    if (tool_opt->noise) noise_print_summary();
+    constructs_finalise();
+    locks_finalise();
+    noise_finalise();
+    filter_finalise();
+    symbols_finalise();
 
     otter_opt_t *opt = tool_data->ptr;
 
@@ -102,6 +318,644 @@ tool_finalise(ompt_data_t *tool_data)
     return;
 }
 
+/* Parse a duration such as "120s", "500ms" or "2m" into ns. A bare number is
+   taken to be in seconds. */
+static uint64_t
+parse_duration(const char *str)
+{
+    if (str == NULL) return 0;
+
+    char *unit = NULL;
+    double value = strtod(str, &unit);
+    double scale = 0;
+
+    if      (STR_EQUAL(unit, "ns")) scale = 1e0;
+    else if (STR_EQUAL(unit, "us")) scale = 1e3;
+    else if (STR_EQUAL(unit, "ms")) scale = 1e6;
+    else if (STR_EQUAL(unit, "s" )) scale = 1e9;
+    else if (STR_EQUAL(unit, ""  )) scale = 1e9;
+    else if (STR_EQUAL(unit, "m" )) scale = 60e9;
+    else if (STR_EQUAL(unit, "h" )) scale = 3600e9;
+
+    if (unit == str || value < 0 || scale == 0)
+    {
+        LOG_ERROR("invalid duration \"%s\" (ignored)", str);
+        return 0;
+    }
+
+    return (uint64_t) (value * scale);
+}
+
+/* Parse a non-negative integer option, where 0 means "not set" */
+static unsigned int
+parse_count(const char *name)
+{
+    const char *str = getenv(name);
+    if (str == NULL) return 0;
+
+    char *end = NULL;
+    long value = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || value < 0 || value > UINT_MAX)
+    {
+        LOG_ERROR("invalid value for %s: \"%s\" (ignored)", name, str);
+        return 0;
+    }
+    return (unsigned int) value;
+}
+
+/* Parse a fraction in (0,1], where 1 means "not set" */
+static double
+parse_fraction(const char *name)
+{
+    const char *str = getenv(name);
+    if (str == NULL) return 1.0;
+
+    char *end = NULL;
+    double value = strtod(str, &end);
+    if (end == str || *end != '\0' || !(value > 0.0 && value <= 1.0))
+    {
+        LOG_ERROR("invalid value for %s: \"%s\" (ignored)", name, str);
+        return 1.0;
+    }
+    return value;
+}
+
+/* Parse a comma-separated list of event classes such as "tasks,parallel". A
+   class prefixed with '-' or '!' is excluded. If only exclusions are given,
+   they are excluded from all classes. Parallel regions are always traced */
+static unsigned int
+parse_event_classes(const char *str)
+{
+    if (str == NULL) return otter_event_all;
+
+    static const struct {const char *name; unsigned int flag;} classes[] = {
+        {"all",       otter_event_all},
+        {"parallel",  otter_event_parallel},
+        {"tasks",     otter_event_tasks},
+        {"sync",      otter_event_sync},
+        {"barrier",   otter_event_barrier},
+        {"workshare", otter_event_workshare},
+        {"master",    otter_event_master}
+    };
+    const size_t n_classes = sizeof(classes) / sizeof(classes[0]);
+
+    unsigned int included = 0, excluded = 0;
+    char list[256] = {0};
+    strncpy(list, str, sizeof(list) - 1);
+
+    char *save = NULL;
+    for (char *tok = strtok_r(list, ", ", &save); tok != NULL;
+        tok = strtok_r(NULL, ", ", &save))
+    {
+        bool negate = (*tok == '-' || *tok == '!');
+        if (negate) tok++;
+
+        size_t k = 0;
+        for (k = 0; k < n_classes; k++)
+            if (STR_EQUAL(tok, classes[k].name)) break;
+
+        if (k == n_classes)
+        {
+            LOG_ERROR("unknown event class \"%s\" in %s (ignored)",
+                tok, ENV_VAR_EVENTS);
+            continue;
+        }
+
+        if (negate) excluded |= classes[k].flag;
+        else        included |= classes[k].flag;
+    }
+
+    if (included == 0) included = otter_event_all;
+
+    LOG_WARN_IF((excluded & otter_event_parallel),
+        "parallel regions are always traced");
+
+    return (included & ~excluded) | otter_event_parallel;
+}
+
+/* Parse a comma-separated list of performance counters to record, where
+   "software" & "hardware" select all counters of that kind */
+static unsigned int
+parse_counters(const char *str)
+{
+    if (str == NULL) return 0;
+
+    static const struct {const char *name; unsigned int flag;} counters[] = {
+        {"software",         otter_counter_software},
+        {"hardware",         otter_counter_hardware},
+        {"task-clock",       otter_counter_task_clock},
+        {"context-switches", otter_counter_context_switches},
+        {"cpu-migrations",   otter_counter_cpu_migrations},
+        {"page-faults",      otter_counter_page_faults},
+        {"cycles",           otter_counter_cycles},
+        {"instructions",     otter_counter_instructions},
+        {"llc-misses",       otter_counter_llc_misses}
+    };
+    const size_t n_counters = sizeof(counters) / sizeof(counters[0]);
+
+    unsigned int selected = 0;
+    char list[256] = {0};
+    strncpy(list, str, sizeof(list) - 1);
+
+    char *save = NULL;
+    for (char *tok = strtok_r(list, ", ", &save); tok != NULL;
+        tok = strtok_r(NULL, ", ", &save))
+    {
+        size_t k = 0;
+        for (k = 0; k < n_counters; k++)
+            if (STR_EQUAL(tok, counters[k].name)) break;
+
+        if (k == n_counters)
+        {
+            LOG_ERROR("unknown counter \"%s\" in %s (ignored)",
+                tok, ENV_VAR_COUNTERS);
+            continue;
+        }
+        selected |= counters[k].flag;
+    }
+    return selected;
+}
+
+/* Parse the lock contention mode: "aggregate" or "trace" */
+static unsigned int
+parse_locks_mode(const char *str)
+{
+    if (str == NULL) return otter_locks_off;
+    if (STR_EQUAL(str, "aggregate")) return otter_locks_aggregate;
+    if (STR_EQUAL(str, "trace"))     return otter_locks_trace;
+    LOG_ERROR("invalid value for %s: \"%s\" (ignored)", ENV_VAR_LOCKS, str);
+    return otter_locks_off;
+}
+
+/* Parse the chunk dispatch mode: "off", "aggregate" (default) or "chunks" */
+static unsigned int
+parse_dispatch_mode(const char *str)
+{
+    if (str == NULL) return otter_dispatch_aggregate;
+    if (STR_EQUAL(str, "off"))       return otter_dispatch_off;
+    if (STR_EQUAL(str, "aggregate")) return otter_dispatch_aggregate;
+    if (STR_EQUAL(str, "chunks"))    return otter_dispatch_chunks;
+    LOG_ERROR("invalid value for %s: \"%s\" (ignored)", ENV_VAR_DISPATCH, str);
+    return otter_dispatch_aggregate;
+}
+
+/* Count the threads executing an implicit task of any team. A thread which is
+   the primary thread of a nested team is only counted once. Writes a marker
+   when there are first more such threads than online CPUs, and when there are
+   no longer. Returns the number of threads after the update */
+static unsigned int
+update_live_threads(thread_data_t *thread_data, ompt_scope_endpoint_t endpoint)
+{
+    size_t online_cpus = 0;
+    trace_topology_cpus(&online_cpus);
+    char text[64] = {0};
+
+    if (endpoint == ompt_scope_begin)
+    {
+        if (thread_data->implicit_depth++ > 0)
+            return __atomic_load_n(&live_threads, __ATOMIC_RELAXED);
+        unsigned int n = __sync_add_and_fetch(&live_threads, 1);
+        atomic_max(&peak_live_threads, n);
+        if (online_cpus > 0 && n == online_cpus + 1)
+        {
+            __atomic_store_n(&oversubscribed_since, get_timestamp(),
+                __ATOMIC_RELAXED);
+            snprintf(text, sizeof(text), "%u OpenMP threads on %zu CPUs",
+                n, online_cpus);
+            trace_event_marker(thread_data->location,
+                trace_marker_oversubscription, text);
+        }
+        return n;
+    }
+
+    if (thread_data->implicit_depth == 0 || --thread_data->implicit_depth > 0)
+        return __atomic_load_n(&live_threads, __ATOMIC_RELAXED);
+    unsigned int n = __sync_sub_and_fetch(&live_threads, 1);
+    if (online_cpus > 0 && n == online_cpus)
+    {
+        uint64_t duration = get_timestamp()
+            - __atomic_load_n(&oversubscribed_since, __ATOMIC_RELAXED);
+        __sync_fetch_and_add(&oversubscribed_time, duration);
+        snprintf(text, sizeof(text), "oversubscribed for %.3f ms",
+            duration / 1e6);
+        trace_event_marker(thread_data->location,
+            trace_marker_oversubscription, text);
+    }
+    return n;
+}
+
+/* Record the size of a team as each of its threads joins it, whether or not
+   the parallel region is traced */
+static void
+record_team_member(
+    parallel_data_t *parallel_data,
+    unsigned int     index,
+    unsigned int     actual_parallelism,
+    unsigned int     live_threads)
+{
+    atomic_max(&parallel_data->peak_threads, live_threads);
+    __atomic_store_n(&parallel_data->team_size, actual_parallelism,
+        __ATOMIC_RELAXED);
+
+    construct_data_t *construct = parallel_data->construct;
+    if (construct == NULL) return;
+    atomic_max(&construct->peak_threads, live_threads);
+    if (index != 0) return;
+
+    __sync_fetch_and_add(&construct->teams, 1);
+    if (actual_parallelism < parallel_data->requested_parallelism)
+        __sync_fetch_and_add(&construct->team_shortfall, 1);
+    atomic_max(&construct->requested, parallel_data->requested_parallelism);
+    unsigned int fewest = __atomic_load_n(&construct->min_team,
+        __ATOMIC_RELAXED);
+    while (actual_parallelism < fewest && !__atomic_compare_exchange_n(
+        &construct->min_team, &fewest, actual_parallelism,
+        false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return;
+}
+
+static void
+atomic_max(unsigned int *dest, unsigned int value)
+{
+    unsigned int prior = __atomic_load_n(dest, __ATOMIC_RELAXED);
+    while (value > prior && !__atomic_compare_exchange_n(
+        dest, &prior, value, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return;
+}
+
+/* Record an implicit task's arrival at the next barrier of its team. Each
+   thread encounters the team's barriers in the same order, so they are told
+   apart by counting them. The last thread to arrive adds the time from the
+   first to the last arrival (the skew) and the time the team waited for the
+   last arrival to its parallel region and to the barrier's construct */
+static void
+record_barrier_arrival(task_data_t *task_data, const void *codeptr_ra)
+{
+    parallel_data_t *parallel_data = task_data->parallel;
+    unsigned int team_size =
+        __atomic_load_n(&parallel_data->team_size, __ATOMIC_RELAXED);
+    if (team_size == 0) return;
+
+    barrier_arrivals_t *arrivals =
+        &parallel_data->arrivals[task_data->barriers++ % BARRIER_ARRIVAL_SLOTS];
+    uint64_t now = get_timestamp();
+
+    uint64_t first = __atomic_load_n(&arrivals->first, __ATOMIC_RELAXED);
+    while (now < first && !__atomic_compare_exchange_n(&arrivals->first,
+        &first, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    uint64_t last = __atomic_load_n(&arrivals->last, __ATOMIC_RELAXED);
+    while (now > last && !__atomic_compare_exchange_n(&arrivals->last,
+        &last, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    __atomic_fetch_add(&arrivals->sum, now, __ATOMIC_RELAXED);
+    if (__atomic_add_fetch(&arrivals->arrived, 1, __ATOMIC_ACQ_REL)
+        < team_size) return;
+
+    /* Every thread has arrived, so none can be updating this barrier's record
+       and none can reuse it until this thread has passed the barrier */
+    first = __atomic_load_n(&arrivals->first, __ATOMIC_RELAXED);
+    last = __atomic_load_n(&arrivals->last, __ATOMIC_RELAXED);
+    uint64_t skew = last - first;
+    uint64_t wait = team_size * last
+        - __atomic_load_n(&arrivals->sum, __ATOMIC_RELAXED);
+    *arrivals = (barrier_arrivals_t) {
+        .arrived = 0,
+        .first   = UINT64_MAX,
+        .last    = 0,
+        .sum     = 0
+    };
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (parallel_data->region != NULL)
+        trace_add_barrier_arrivals(parallel_data->region, skew, wait);
+
+    construct_data_t *construct =
+        codeptr_ra ? get_construct_data(codeptr_ra) : NULL;
+    if (construct == NULL) return;
+    __sync_fetch_and_add(&construct->barriers, 1);
+    __sync_fetch_and_add(&construct->barrier_skew, skew);
+    __sync_fetch_and_add(&construct->barrier_wait, wait);
+    uint64_t max = __atomic_load_n(&construct->max_barrier_skew,
+        __ATOMIC_RELAXED);
+    while (skew > max && !__atomic_compare_exchange_n(
+        &construct->max_barrier_skew, &max, skew,
+        false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return;
+}
+
+/* Tasks which are merged, final or included, or undeferred execute as soon as
+   they are created, serialising their creator */
+static trace_task_category_t
+task_category(int flags)
+{
+    if (flags & ompt_task_merged)     return trace_task_merged;
+    if (flags & ompt_task_final)      return trace_task_final;
+    if (flags & ompt_task_undeferred) return trace_task_undeferred;
+    return trace_task_deferred;
+}
+
+/* Add a completed explicit task's execution time to its category. With
+   OTTER_GRANULARITY set, also add it to its construct's tasks at the same
+   depth together with the time spent in its descendants which have completed,
+   and give its parent the total */
+static void
+record_task_category_time(task_data_t *task_data)
+{
+    task_lineage_t *lineage = task_data->lineage;
+    if (tool_opt->granularity > 0)
+    {
+        uint64_t subtree_time = task_data->exec_time + (lineage == NULL ? 0 :
+            __atomic_load_n(&lineage->subtree_time, __ATOMIC_RELAXED));
+        if (lineage != NULL && lineage->parent != NULL)
+            __sync_fetch_and_add(&lineage->parent->subtree_time, subtree_time);
+        if (task_data->construct != NULL)
+        {
+            unsigned int depth = task_data->depth < TASK_DEPTH_BINS ?
+                task_data->depth : TASK_DEPTH_BINS - 1;
+            __sync_fetch_and_add(
+                &task_data->construct->depth_tasks[depth], 1);
+            __sync_fetch_and_add(
+                &task_data->construct->depth_time[depth], subtree_time);
+        }
+    }
+
+    trace_task_category_t category = task_category(task_data->flags);
+    if (task_data->construct != NULL)
+        __sync_fetch_and_add(&task_data->construct->category_time[category],
+            task_data->exec_time);
+    if (task_data->parallel != NULL && task_data->parallel->region != NULL)
+        trace_add_task_category(task_data->parallel->region, category,
+            0, task_data->exec_time);
+    if (task_data->parallel != NULL)
+    {
+        __sync_fetch_and_add(&task_data->parallel->tasks_completed, 1);
+        __sync_fetch_and_add(&task_data->parallel->completed_time,
+            task_data->exec_time);
+    }
+    return;
+}
+
+/* A task's children can no longer be created once it has completed, so the
+   last writers of their dependences are no longer needed */
+static void
+release_dependence_map(task_data_t *task_data)
+{
+    hashmap_destroy(task_data->last_writer, false, NULL);
+    task_data->last_writer = NULL;
+    return;
+}
+
+/* The record of the tasks a thread creates as a member of the team of a traced
+   parallel region, or NULL */
+static task_producer_t *
+task_producer(thread_data_t *thread_data, parallel_data_t *parallel_data)
+{
+    if (parallel_data == NULL || parallel_data->producers == NULL) return NULL;
+    if (thread_data->team_rank >= parallel_data->requested_parallelism)
+        return NULL;
+    return &parallel_data->producers[thread_data->team_rank];
+}
+
+/* A thread waiting in a sync region is idle except while it executes a task.
+   An idle interval which ends because a task starts is time the thread was
+   starved of ready tasks, while one which ends with the wait is not */
+static void
+begin_idle(thread_data_t *thread_data, task_data_t *task_data)
+{
+    thread_data->idle_since =
+        task_data->parallel != NULL ? get_timestamp() : 0;
+    thread_data->idle_parallel = task_data->parallel;
+    return;
+}
+
+static void
+end_idle(thread_data_t *thread_data, bool starved)
+{
+    if (thread_data->idle_since == 0) return;
+    if (starved)
+        __sync_fetch_and_add(&thread_data->idle_parallel->starved_time,
+            get_timestamp() - thread_data->idle_since);
+    thread_data->idle_since = 0;
+    return;
+}
+
+/* Once the team has passed the final barrier of a traced parallel region, find
+   the member which created the most tasks. The region is producer-bound if
+   that member created at least TASK_PRODUCER_SHARE percent of them, at a lower
+   rate than the team could execute them (its size over the mean task
+   duration), while threads were starved of ready tasks */
+static void
+record_task_production(parallel_data_t *parallel_data)
+{
+    if (parallel_data->producers == NULL) return;
+
+    trace_task_production_t production = {0};
+    task_producer_t *top = NULL;
+    unsigned int k=0;
+    for (k=0; k<parallel_data->requested_parallelism; k++)
+    {
+        task_producer_t *producer = &parallel_data->producers[k];
+        if (producer->tasks == 0) continue;
+        production.producers++;
+        production.tasks += producer->tasks;
+        if (top == NULL || producer->tasks > top->tasks) top = producer;
+    }
+    if (top == NULL) return;
+
+    uint64_t window = top->last - top->first;
+    uint64_t completed_time = parallel_data->completed_time;
+    unsigned int team_size =
+        __atomic_load_n(&parallel_data->team_size, __ATOMIC_RELAXED);
+    production.top_producer_tasks = top->tasks;
+    production.producer_time = top->callback_time;
+    production.creation_rate = window == 0 ? 0 :
+        (uint64_t) ((top->tasks - 1) * 1e9 / window);
+    production.consumption_rate = completed_time == 0 ? 0 :
+        (uint64_t) ((double) team_size * parallel_data->tasks_completed
+            * 1e9 / completed_time);
+    production.starved_time = parallel_data->starved_time;
+    production.bottleneck = window > 0
+        && top->tasks * 100 >= production.tasks * TASK_PRODUCER_SHARE
+        && production.starved_time > 0
+        && production.creation_rate < production.consumption_rate;
+    trace_set_task_production(parallel_data->region, &production);
+
+    construct_data_t *construct = parallel_data->construct;
+    if (construct == NULL) return;
+    __sync_fetch_and_add(&construct->producing_regions, 1);
+    __sync_fetch_and_add(&construct->producer_time, production.producer_time);
+    __sync_fetch_and_add(&construct->starved_time, production.starved_time);
+    if (production.bottleneck)
+        __sync_fetch_and_add(&construct->producer_bottlenecks, 1);
+    return;
+}
+
+/* Whether a task executed by a thread in a taskwait or taskgroup region is a
+   descendant of the task waiting in the innermost such region */
+static bool
+waiting_for_descendant(thread_data_t *thread_data, task_data_t *task_data)
+{
+    data_item_t item = {.ptr = NULL};
+    if (!stack_peek(thread_data->waiting_tasks, &item)) return false;
+    return task_is_descendant(task_data, item.ptr);
+}
+
+/* Update the statistics of a traced task's construct when it completes, and
+   throttle the construct once its tasks are both frequent and short: more than
+   OTTER_THROTTLE_RATE tasks per second per thread, with a mean duration below
+   OTTER_THROTTLE_DURATION. Checked every THROTTLE_CHECK_INTERVAL tasks */
+static void
+record_task_completion(thread_data_t *thread_data, task_data_t *task_data)
+{
+    construct_data_t *construct = task_data->construct;
+    uint64_t n = __sync_add_and_fetch(&construct->tasks, 1);
+    uint64_t time = __sync_add_and_fetch(
+        &construct->task_time, task_data->exec_time);
+
+    if (n % THROTTLE_CHECK_INTERVAL != 0) return;
+    if (__atomic_load_n(&construct->throttled, __ATOMIC_RELAXED)) return;
+
+    uint64_t elapsed = get_timestamp() - construct->first_seen;
+    unsigned int threads =
+        __atomic_load_n(&running_threads, __ATOMIC_RELAXED);
+    double rate = (elapsed == 0 || threads == 0) ? 0.0 :
+        (double) n * 1e9 / (double) elapsed / (double) threads;
+    uint64_t mean = time / n;
+
+    if (rate <= tool_opt->throttle_rate) return;
+    if (mean >= tool_opt->throttle_duration) return;
+
+    /* Only the thread which sets the flag records the decision */
+    if (!__sync_bool_compare_and_swap(&construct->throttled, false, true))
+        return;
+
+    char text[128] = {0};
+    snprintf(text, sizeof(text),
+        "throttled task construct %p (%.0f tasks/s/thread, mean %lu ns)",
+        construct->codeptr_ra, rate, mean);
+    LOG_INFO("[t=%lu] %s", thread_data->id, text);
+    trace_event_marker(thread_data->location, trace_marker_throttling, text);
+    return;
+}
+
+/* Measure the time from an explicit task's creation until it first starts, and
+   whether it was stolen from the thread which created it. A task without
+   dependences is ready once created so all of this time is spent queued, but
+   OMPT doesn't report when a task's dependences are satisfied */
+static void
+record_task_start(thread_data_t *thread_data, task_data_t *task_data)
+{
+    uint64_t latency = get_timestamp() - task_data->create_time;
+    uint64_t queued = task_data->has_dependences ? 0 : latency;
+    bool stolen = task_data->creating_thread != thread_data->id;
+    task_data->started = true;
+
+    trace_add_task_start(thread_data->location, task_data->region,
+        latency, queued, stolen);
+
+    /* The construct may not have been registered if the registry was full */
+    construct_data_t *construct = task_data->construct;
+    if (construct == NULL) return;
+    __sync_fetch_and_add(&construct->started, 1);
+    __sync_fetch_and_add(&construct->start_latency, latency);
+    __sync_fetch_and_add(&construct->latency_histogram[
+        histogram_bin(latency, TASK_LATENCY_BINS)], 1);
+    if (stolen) __sync_fetch_and_add(&construct->stolen, 1);
+    if (!task_data->has_dependences)
+    {
+        __sync_fetch_and_add(&construct->queued, 1);
+        __sync_fetch_and_add(&construct->queued_time, queued);
+    }
+    return;
+}
+
+/* Write a marker if the thread was preempted since its previous sample, i.e.
+   during the parallel region it is entering or leaving */
+static void
+sample_noise(thread_data_t *thread_data)
+{
+    if (thread_data->noise == NULL) return;
+
+    uint64_t preemptions = 0, wait_time = 0;
+    if (!noise_sample(thread_data->noise, &preemptions, &wait_time)) return;
+
+    char text[128] = {0};
+    snprintf(text, sizeof(text),
+        "thread %lu preempted %lu times (%lu us waiting for a CPU)",
+        thread_data->id, preemptions, wait_time / 1000);
+    trace_event_marker(thread_data->location, trace_marker_preemption, text);
+    return;
+}
+
+/* Capture the call stack for 1 in every OTTER_CALLSTACKS parallel-begin and
+   task-create events on each thread */
+static uint32_t
+sample_callstack(thread_data_t *thread_data, const void *codeptr_ra)
+{
+    if (tool_opt->callstacks == 0) return CALLSTACK_NONE;
+    if (++thread_data->callstack_events < tool_opt->callstacks)
+        return CALLSTACK_NONE;
+    thread_data->callstack_events = 0;
+    return trace_callstack_capture(codeptr_ra);
+}
+
+/* Decide whether a task created by a traced task is traced along with its
+   subtree. Root-level subtrees (those of tasks created by an implicit or
+   initial task) are traced with probability OTTER_SAMPLE_TASKS, spread evenly
+   by carrying the remainder over between decisions on each thread. Tasks below
+   OTTER_TASK_MAX_DEPTH are never traced */
+static bool
+sample_task_subtree(thread_data_t *thread_data, task_data_t *parent_task_data)
+{
+    unsigned int depth = parent_task_data->depth + 1;
+
+    if (tool_opt->task_max_depth > 0 && depth > tool_opt->task_max_depth)
+        return false;
+
+    if (depth == 1 && tool_opt->sample_tasks < 1.0)
+    {
+        thread_data->subtree_credit += tool_opt->sample_tasks;
+        if (thread_data->subtree_credit < 1.0) return false;
+        thread_data->subtree_credit -= 1.0;
+    }
+
+    return true;
+}
+
+/* Decide whether the next instance of a parallel construct is traced. The
+   first OTTER_SAMPLE_PARALLEL_FIRST instances are traced, then 1 in every
+   OTTER_SAMPLE_PARALLEL. Without either option every instance is traced */
+static bool
+sample_parallel_region(construct_data_t *construct)
+{
+    unsigned int every = tool_opt->sample_parallel;
+    unsigned int first = tool_opt->sample_parallel_first;
+
+    if (construct == NULL) return true;
+
+    uint64_t n = __sync_fetch_and_add(&construct->instances, 1);
+    bool traced = (every == 0 && first == 0)
+        || n < first
+        || (every > 0 && (n - first) % every == 0);
+
+    __sync_fetch_and_add(traced ? &construct->traced : &construct->untraced, 1);
+    return traced;
+}
+
+/* Changes to the activation state only take effect at the boundaries of an
+   outermost parallel region, and only while the initial thread has no region
+   open except the initial task, so that all region stacks stay well-formed */
+static void
+update_activation_state(thread_data_t *thread_data, task_data_t *task_data)
+{
+    if (task_data->type == ompt_task_initial
+        && task_data->untraced_depth == 0
+        && stack_size(thread_data->location->rgn_stack) == 1)
+    {
+        activation_update();
+    }
+    return;
+}
+
 static void
 print_resource_usage(void)
 {
@@ -125,6 +979,227 @@ print_resource_usage(void)
         get_unique_task_id(), "");
 }
 
+static void
+print_throttling_summary(void)
+{
+    if (tool_opt->throttle_rate == 0) return;
+
+    construct_data_t *construct = NULL;
+    size_t next = 0;
+    fprintf(stderr, "\nTASK CONSTRUCT THROTTLING:\n");
+    fprintf(stderr, "%18s %12s %12s %12s %16s\n",
+        "construct", "traced", "mean (ns)", "throttled", "throttled (ms)");
+    while (construct_scan(&construct, &next))
+    {
+        if (!construct->throttled) continue;
+        fprintf(stderr, "%18p %12lu %12lu %12lu %16.3f\n",
+            construct->codeptr_ra,
+            construct->tasks,
+            construct->tasks ? construct->task_time / construct->tasks : 0,
+            construct->throttled_tasks,
+            construct->throttled_time / 1e6);
+    }
+}
+
+static void
+print_scheduling_summary(void)
+{
+    construct_data_t *construct = NULL;
+    size_t next = 0;
+    bool header = false;
+    while (construct_scan(&construct, &next))
+    {
+        if (construct->started == 0) continue;
+        if (!header)
+        {
+            fprintf(stderr, "\nTASK SCHEDULING:\n");
+            fprintf(stderr, "%18s %12s %10s %14s %12s %12s %14s\n",
+                "construct", "started", "stolen (%)", "mean lat. (ns)",
+                "p50 (ns)", "p99 (ns)", "queued (ns)");
+            header = true;
+        }
+        fprintf(stderr, "%18p %12lu %10.1f %14lu %12lu %12lu %14lu\n",
+            construct->codeptr_ra,
+            construct->started,
+            100.0 * construct->stolen / construct->started,
+            construct->start_latency / construct->started,
+            histogram_percentile(construct->latency_histogram,
+                TASK_LATENCY_BINS, 0.50),
+            histogram_percentile(construct->latency_histogram,
+                TASK_LATENCY_BINS, 0.99),
+            construct->queued ? construct->queued_time / construct->queued : 0);
+    }
+}
+
+/* Explicit tasks of each construct by how they were executed. A construct
+   whose tasks are mostly undeferred, final or merged has its work serialised,
+   e.g. by a cutoff or because the runtime limited the number of queued tasks */
+static void
+print_task_category_summary(void)
+{
+    construct_data_t *construct = NULL;
+    size_t next = 0;
+    bool header = false;
+    while (construct_scan(&construct, &next))
+    {
+        uint64_t *tasks = construct->category_tasks;
+        uint64_t *time = construct->category_time;
+        if (tasks[trace_task_deferred] + tasks[trace_task_undeferred]
+            + tasks[trace_task_final] + tasks[trace_task_merged] == 0) continue;
+        if (!header)
+        {
+            fprintf(stderr, "\nTASK EXECUTION (tasks / time in ms):\n");
+            fprintf(stderr, "%18s %21s %21s %21s %21s\n",
+                "construct", "deferred", "undeferred", "final", "merged");
+            header = true;
+        }
+        fprintf(stderr, "%18p", construct->codeptr_ra);
+        int k=0;
+        for (k=0; k<NUM_TASK_CATEGORIES; k++)
+            fprintf(stderr, " %10lu %10.3f", tasks[k], time[k] / 1e6);
+        fprintf(stderr, "\n");
+    }
+}
+
+/* Parallel constructs which were given fewer threads than they requested, or
+   began a team while more OpenMP threads were executing than there are CPUs */
+static void
+print_parallelism_summary(void)
+{
+    size_t online_cpus = 0;
+    trace_topology_cpus(&online_cpus);
+
+    construct_data_t *construct = NULL;
+    size_t next = 0;
+    bool header = false;
+    while (construct_scan(&construct, &next))
+    {
+        if (construct->team_shortfall == 0 && construct->oversubscribed == 0)
+            continue;
+        if (!header)
+        {
+            fprintf(stderr, "\nPARALLEL REGION TEAMS (%zu online CPUs, "
+                "at most %u OpenMP threads, oversubscribed for %.3f ms):\n",
+                online_cpus, peak_live_threads, oversubscribed_time / 1e6);
+            fprintf(stderr, "%18s %12s %10s %10s %12s %14s %12s\n",
+                "construct", "teams", "requested", "fewest", "shortfall",
+                "oversubscribed", "peak threads");
+            header = true;
+        }
+        fprintf(stderr, "%18p %12lu %10u %10u %12lu %14lu %12u\n",
+            construct->codeptr_ra,
+            construct->teams,
+            construct->requested,
+            construct->min_team,
+            construct->team_shortfall,
+            construct->oversubscribed,
+            construct->peak_threads);
+    }
+}
+
+/* The barriers (identified by their code address, so the implicit barrier of
+   each worksharing loop is listed separately) with the most arrival skew */
+static void
+print_barrier_summary(void)
+{
+    size_t n = 0, k = 0, next = 0;
+    construct_data_t *construct = NULL;
+    while (construct_scan(&construct, &next))
+        if (construct->barriers > 0) n++;
+    if (n == 0) return;
+
+    construct_data_t **sorted = malloc(n * sizeof(*sorted));
+    next = 0;
+    while (k < n && construct_scan(&construct, &next))
+        if (construct->barriers > 0) sorted[k++] = construct;
+    n = k;
+    qsort(sorted, n, sizeof(*sorted), compare_barrier_skew);
+
+    fprintf(stderr, "\nBARRIER ARRIVAL SKEW (top %d by total skew):\n",
+        BARRIER_REPORT_TOP);
+    fprintf(stderr, "%18s %12s %14s %14s %12s  %s\n",
+        "construct", "barriers", "mean skew (us)", "max skew (us)",
+        "wait (ms)", "location");
+    for (k=0; k<n && k<BARRIER_REPORT_TOP; k++)
+    {
+        construct_data_t *c = sorted[k];
+        const symbol_info_t *sym = symbols_lookup(c->codeptr_ra, false);
+        fprintf(stderr, "%18p %12lu %14.3f %14.3f %12.3f  %s\n",
+            c->codeptr_ra,
+            c->barriers,
+            c->barrier_skew / 1e3 / c->barriers,
+            c->max_barrier_skew / 1e3,
+            c->barrier_wait / 1e6,
+            sym && sym->function ? sym->function : "?");
+    }
+    free(sorted);
+}
+
+/* Parallel constructs with a region whose tasks were mostly created by one
+   thread which couldn't keep the rest of the team busy */
+static void
+print_producer_summary(void)
+{
+    construct_data_t *construct = NULL;
+    size_t next = 0;
+    bool header = false;
+    while (construct_scan(&construct, &next))
+    {
+        if (construct->producer_bottlenecks == 0) continue;
+        if (!header)
+        {
+            fprintf(stderr, "\nTASK PRODUCER BOTTLENECKS (one thread created "
+                "at least %d%% of the tasks, slower than the team could "
+                "execute them):\n", TASK_PRODUCER_SHARE);
+            fprintf(stderr, "%18s %12s %12s %16s %12s  %s\n",
+                "construct", "regions", "bottlenecks", "producer (ms)",
+                "starved (ms)", "location");
+            header = true;
+        }
+        const symbol_info_t *sym = symbols_lookup(construct->codeptr_ra, false);
+        fprintf(stderr, "%18p %12lu %12lu %16.3f %12.3f  %s\n",
+            construct->codeptr_ra,
+            construct->producing_regions,
+            construct->producer_bottlenecks,
+            construct->producer_time / 1e6,
+            construct->starved_time / 1e6,
+            sym && sym->function ? sym->function : "?");
+    }
+}
+
+/* Sort by descending total skew */
+static int
+compare_barrier_skew(const void *a, const void *b)
+{
+    const construct_data_t *x = *(construct_data_t * const *) a;
+    const construct_data_t *y = *(construct_data_t * const *) b;
+    return (x->barrier_skew < y->barrier_skew)
+        - (x->barrier_skew > y->barrier_skew);
+}
+
+static void
+print_sampling_summary(void)
+{
+    if (tool_opt->sample_parallel == 0 && tool_opt->sample_parallel_first == 0)
+        return;
+
+    construct_data_t *construct = NULL;
+    size_t next = 0;
+    fprintf(stderr, "\nPARALLEL REGION SAMPLING:\n");
+    fprintf(stderr, "%18s %12s %12s %12s %16s\n",
+        "construct", "instances", "traced", "untraced", "untraced (ms)");
+    while (construct_scan(&construct, &next))
+    {
+        if (construct->instances == 0) continue;
+        fprintf(stderr, "%18p %12lu %12lu %12lu %16.3f\n",
+            construct->codeptr_ra,
+            construct->instances,
+            construct->traced,
+            construct->untraced,
+            construct->untraced_time / 1e6);
+    }
+}
+
 static void
 on_ompt_callback_thread_begin(
     ompt_thread_t            thread_type,
@@ -132,9 +1207,19 @@ on_ompt_callback_thread_begin(
 {   
     thread_data_t *thread_data = new_thread_data(thread_type);
     thread->ptr = thread_data;
+    __sync_fetch_and_add(&running_threads, 1);
+    if (tool_opt->locks != otter_locks_off)
+        thread_data->locks = locks_new_table();
+    if (tool_opt->noise)
+        thread_data->noise = noise_new_stats(thread_data->id);
+    if (tool_opt->granularity > 0)
+        thread_data->creation = granularity_new_stats();
 
     LOG_DEBUG("[t=%lu] (event) thread-begin", thread_data->id);
 
+    /* The thread's initial place, if it is bound to one */
+    thread_data->location->place = get_place_num != NULL ? get_place_num() : -1;
+
     /* Record thread-begin event */
     trace_event_thread_begin(thread_data->location);
 
@@ -158,6 +1243,13 @@ on_ompt_callback_thread_end(
 
     /* Record thread-end event */
     trace_event_thread_end(thread_data->location);
+    __sync_fetch_and_sub(&running_threads, 1);
+
+    /* Lock statistics are only shared once the thread is done with them */
+    locks_merge_table(thread_data->locks);
+    noise_merge_stats(thread_data->noise, thread_data->location->migrations);
+    granularity_merge_stats(thread_data->creation);
+    thread_data->creation = NULL;
 
     /* Destroy thread data (also destroys thread_data->location) */
     thread_destroy(thread_data);
@@ -174,12 +1266,20 @@ on_ompt_callback_parallel_begin(
     int                      flags,
     const void              *codeptr_ra)
 {
-    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
     task_data_t *task_data = (task_data_t*) encountering_task->ptr;
+    if (task_data == NULL) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
 
     LOG_DEBUG("[t=%lu] (event) parallel-begin", thread_data->id);
 
-    thread_data->is_master_thread = true;
+    update_activation_state(thread_data, task_data);
+    if (!TASK_ENCOUNTERS_TRACED(task_data)) return;
+    if (!filter_include(codeptr_ra)) return;
+
+    /* All threads in the team see the sampling decision via parallel_data */
+    construct_data_t *construct = get_construct_data(codeptr_ra);
+    bool traced = sample_parallel_region(construct);
 
     /* assign space for this parallel region */
     parallel_data_t *parallel_data = new_parallel_data(
@@ -188,9 +1288,17 @@ on_ompt_callback_parallel_begin(
         task_data->id,
         task_data,
         requested_parallelism,
-        flags);
+        flags,
+        construct,
+        traced,
+        codeptr_ra,
+        traced ? sample_callstack(thread_data, codeptr_ra) : CALLSTACK_NONE);
     parallel->ptr = parallel_data;
 
+    if (!traced) return;
+
+    thread_data->is_master_thread = true;
+
     /* record enter region event */
     trace_event_enter(thread_data->location, parallel_data->region);
 
@@ -204,20 +1312,49 @@ on_ompt_callback_parallel_end(
     int          flags,
     const void  *codeptr_ra)
 {
+    task_data_t *task_data = (task_data_t*) encountering_task->ptr;
+    if (task_data == NULL) return;
+
     thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
 
     LOG_DEBUG("[t=%lu] (event) parallel-end", thread_data->id);
 
-    if ((parallel == NULL) || (parallel->ptr == NULL))
+    if (parallel == NULL)
     {
         LOG_ERROR("parallel end: null pointer");
-    } else {
+    } else if (parallel->ptr != NULL) {
         parallel_data_t *parallel_data = parallel->ptr;
-        trace_event_leave(thread_data->location);
-        /* reset flag */
-        thread_data->is_master_thread = false;
+        size_t online_cpus = 0;
+        trace_topology_cpus(&online_cpus);
+        if (parallel_data->construct != NULL && online_cpus > 0
+            && parallel_data->peak_threads > online_cpus)
+        {
+            __sync_fetch_and_add(&parallel_data->construct->oversubscribed, 1);
+        }
+        if (parallel_data->traced)
+        {
+            record_task_production(parallel_data);
+            trace_event_leave(thread_data->location);
+            /* reset flag */
+            thread_data->is_master_thread = false;
+        } else {
+            /* Only aggregate the duration of a sampled-out instance. The team
+               has joined so no other thread refers to parallel_data */
+            construct_data_t *construct = parallel_data->construct;
+            uint64_t duration = get_timestamp() - parallel_data->begin_time;
+            if (construct != NULL)
+            {
+                __sync_fetch_and_add(&construct->untraced_time, duration);
+                __sync_fetch_and_add(&construct->pending_skipped, 1);
+                __sync_fetch_and_add(&construct->pending_time, duration);
+            }
+            parallel->ptr = NULL;
+            parallel_destroy(parallel_data);
+        }
     }
 
+    update_activation_state(thread_data, task_data);
+
     return;
 }
 
@@ -270,9 +1407,6 @@ on_ompt_callback_task_create(
     int                  has_dependences,
     const void          *codeptr_ra)
 {
-    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
-    LOG_DEBUG("[t=%lu] BEGIN EVENT", thread_data->id);
-
     /* Intel runtime seems to give the initial task a task-create event while
        LLVM just gives it an implicit-task-begin event. If invoked by Intel,
        defer initial task data creation until the implicit-task-begin event for
@@ -283,29 +1417,287 @@ on_ompt_callback_task_create(
         return;
     }
 
-    LOG_DEBUG("[t=%lu] (event) task-create", thread_data->id);
-
     /* get the task data of the parent, if it exists */
     task_data_t *parent_task_data = flags & ompt_task_initial ? 
         NULL : (task_data_t*) encountering_task->ptr;
 
+    /* Tasks created by an untraced task are not traced */
+    if (parent_task_data == NULL) return;
+    if (parent_task_data->region != NULL
+        && !TASK_ENCOUNTERS_TRACED(parent_task_data)) return;
+    if (!filter_include(codeptr_ra)) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    uint64_t callback_begin = get_timestamp();
+    LOG_DEBUG("[t=%lu] BEGIN EVENT", thread_data->id);
+
+    LOG_DEBUG("[t=%lu] (event) task-create", thread_data->id);
+
+    construct_data_t *construct = get_construct_data(codeptr_ra);
+    bool throttled = false;
+
+    /* Descendants of a sampled-out task are counted into the same traced
+       ancestor as their parent */
+    task_data_t *traced_ancestor = NULL;
+    if (parent_task_data->region == NULL)
+    {
+        traced_ancestor = parent_task_data->traced_ancestor;
+    } else if (construct != NULL
+            && __atomic_load_n(&construct->throttled, __ATOMIC_RELAXED)) {
+        traced_ancestor = parent_task_data;
+        throttled = true;
+    } else if (!sample_task_subtree(thread_data, parent_task_data)) {
+        traced_ancestor = parent_task_data;
+    }
+
     /* make space for the newly-created task */
     task_data_t *task_data = new_task_data(thread_data->location, 
-        parent_task_data ? parent_task_data->region : NULL, 
-        get_unique_task_id(), flags, has_dependences);
+        parent_task_data->region, get_unique_task_id(), flags, has_dependences,
+        parent_task_data->depth + 1, traced_ancestor, codeptr_ra,
+        traced_ancestor == NULL ?
+            sample_callstack(thread_data, codeptr_ra) : CALLSTACK_NONE);
+    task_data->parallel  = parent_task_data->parallel;
+    task_data->construct = construct;
+    task_data->throttled = throttled;
+    task_data->create_time = get_timestamp();
+    task_data->creating_thread = thread_data->id;
+    if (has_dependences)
+    {
+        if (parent_task_data->last_writer == NULL)
+            parent_task_data->last_writer =
+                hashmap_create(DEPENDENCE_MAP_CAPACITY);
+        task_data->sibling_writers = parent_task_data->last_writer;
+    }
+    if (LINEAGE_NEEDED(tool_opt))
+        task_data->lineage = new_task_lineage(
+            parent_task_data->lineage, task_data->depth);
+
+    trace_task_category_t category = task_category(flags);
+    if (construct != NULL)
+        __sync_fetch_and_add(&construct->category_tasks[category], 1);
+    if (task_data->parallel != NULL && task_data->parallel->region != NULL)
+        trace_add_task_category(task_data->parallel->region, category, 1, 0);
+
+    if (throttled)
+    {
+        __sync_fetch_and_add(&construct->throttled_tasks, 1);
+        if (task_data->parallel != NULL)
+            trace_add_throttled_tasks(task_data->parallel->region, 1, 0);
+    }
 
     /* record the task-create event */
-    trace_event_task_create(thread_data->location, task_data->region);
+    if (task_data->region != NULL)
+    {
+        trace_set_task_identity(task_data->region,
+            task_data->parallel != NULL ? task_data->parallel->region : NULL,
+            thread_data->team_rank, ++thread_data->task_generation);
+        trace_event_task_create(thread_data->location, task_data->region);
+    }
 
     new_task->ptr = task_data;
 
+    /* Time spent here delays the creating thread's next task */
+    uint64_t callback_end = get_timestamp();
+    task_producer_t *producer = task_producer(thread_data, task_data->parallel);
+    if (producer != NULL)
+    {
+        if (producer->tasks++ == 0) producer->first = callback_begin;
+        producer->last = callback_begin;
+        producer->callback_time += callback_end - callback_begin;
+    }
+    granularity_task_created(thread_data->creation, parent_task_data->id,
+        callback_begin, callback_end);
+
     LOG_DEBUG_TASK_TYPE(thread_data->id, 
-        parent_task_data ? parent_task_data->id : 0L, task_data->id, flags);
+        parent_task_data->id, task_data->id, flags);
     
     LOG_DEBUG("[t=%lu] END EVENT", thread_data->id);
     return;
 }
 
+/* Mutex callbacks, registered if OTTER_LOCKS is set. Each thread records its
+   own acquisitions (see otter-locks.h) */
+static void
+on_ompt_callback_lock_init(
+    ompt_mutex_t             kind,
+    unsigned int             hint,
+    unsigned int             impl,
+    ompt_wait_id_t           wait_id,
+    const void              *codeptr_ra)
+{
+    LOG_DEBUG("(event) lock-init: %#lx", (unsigned long) wait_id);
+    locks_record_init(wait_id, codeptr_ra);
+    return;
+}
+
+static void
+on_ompt_callback_lock_destroy(
+    ompt_mutex_t             kind,
+    ompt_wait_id_t           wait_id,
+    const void              *codeptr_ra)
+{
+    LOG_DEBUG("(event) lock-destroy: %#lx", (unsigned long) wait_id);
+    return;
+}
+
+static void
+on_ompt_callback_mutex_acquire(
+    ompt_mutex_t             kind,
+    unsigned int             hint,
+    unsigned int             impl,
+    ompt_wait_id_t           wait_id,
+    const void              *codeptr_ra)
+{
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    if (thread_data == NULL) return;
+    locks_acquire(thread_data->locks);
+    return;
+}
+
+static void
+on_ompt_callback_mutex_acquired(
+    ompt_mutex_t             kind,
+    ompt_wait_id_t           wait_id,
+    const void              *codeptr_ra)
+{
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    if (thread_data == NULL) return;
+    locks_acquired(thread_data->locks, kind, wait_id, codeptr_ra);
+    return;
+}
+
+static void
+on_ompt_callback_mutex_released(
+    ompt_mutex_t             kind,
+    ompt_wait_id_t           wait_id,
+    const void              *codeptr_ra)
+{
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    if (thread_data == NULL) return;
+
+    uint64_t wait_time = 0, hold_time = 0;
+    const lock_stats_t *stats = locks_released(
+        thread_data->locks, wait_id, &wait_time, &hold_time);
+
+    if (stats != NULL && tool_opt->locks == otter_locks_trace
+        && tracing_active)
+    {
+        trace_event_mutex_release(thread_data->location, kind, wait_id,
+            stats->codeptr_ra, wait_time, hold_time);
+    }
+    return;
+}
+
+/* Called after task-create for a task with dependences. Each address is mapped
+   to the last sibling task which wrote it (out/inout), giving the
+   read-after-write & write-after-write edges even when the predecessor has
+   already completed. Other edges are reported by task-dependence */
+static void
+on_ompt_callback_dependences(
+    ompt_data_t             *task,
+    const ompt_dependence_t *deps,
+    int                      ndeps)
+{
+    task_data_t *task_data = (task_data_t*) task->ptr;
+    if (task_data == NULL || task_data->type != ompt_task_explicit) return;
+
+    /* Dependences only relate siblings, so each parent has its own map. It
+       is only needed while the parent is creating this task */
+    hashmap_t *last_writer = task_data->sibling_writers;
+    task_data->sibling_writers = NULL;
+    if (last_writer == NULL) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    uint64_t callback_begin = get_timestamp();
+    LOG_DEBUG("[t=%lu] (event) dependences: task %lu has %d",
+        thread_data->id, task_data->id, ndeps);
+
+    /* Items are the writer's ID and whether it is traced, never 0 */
+    bool traced = task_data->region != NULL;
+    data_item_t writer = {.value = (task_data->id + 1) << 1 | traced};
+
+    /* Remember the edges written here, so that the runtime's report of the
+       same edges to task-dependence isn't written again */
+    if (thread_data->sink_predecessors == NULL)
+        thread_data->sink_predecessors =
+            hashmap_create(SINK_PREDECESSORS_CAPACITY);
+    else
+        hashmap_clear(thread_data->sink_predecessors);
+    thread_data->dependence_sink = task_data->id;
+
+    int k=0;
+    for (k=0; k<ndeps; k++)
+    {
+        uint64_t address = (uint64_t) deps[k].variable.ptr;
+        ompt_dependence_type_t type = deps[k].dependence_type;
+
+        /* doacross dependences aren't between tasks */
+        if (type == ompt_dependence_type_source
+            || type == ompt_dependence_type_sink) continue;
+
+        data_item_t prior = {.value = 0};
+        bool known = hashmap_find(last_writer, address, &prior);
+        if (type == ompt_dependence_type_out
+            || type == ompt_dependence_type_inout)
+        {
+            /* Keep the map's existing edges rather than overfill it */
+            if (known
+                || hashmap_size(last_writer) < DEPENDENCE_MAP_CAPACITY / 2)
+            {
+                hashmap_exchange(last_writer, address, writer);
+            } else {
+                __sync_fetch_and_add(&dependences_dropped, 1);
+            }
+        }
+
+        /* Only edges between two traced tasks are written */
+        if (traced && (prior.value & 1))
+        {
+            unique_id_t predecessor = (prior.value >> 1) - 1;
+            trace_event_task_dependence(thread_data->location, task_data->id,
+                predecessor, address, type);
+            hashmap_insert(thread_data->sink_predecessors, predecessor,
+                (data_item_t) {.value = 1});
+        }
+    }
+
+    task_producer_t *producer = task_producer(thread_data, task_data->parallel);
+    if (producer != NULL)
+        producer->callback_time += get_timestamp() - callback_begin;
+    return;
+}
+
+/* Called when the runtime makes sink_task wait for src_task */
+static void
+on_ompt_callback_task_dependence(
+    ompt_data_t             *src_task,
+    ompt_data_t             *sink_task)
+{
+    task_data_t *src_task_data = (task_data_t*) src_task->ptr;
+    task_data_t *sink_task_data = (task_data_t*) sink_task->ptr;
+    if (src_task_data == NULL || src_task_data->region == NULL
+        || sink_task_data == NULL || sink_task_data->region == NULL) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    LOG_DEBUG("[t=%lu] (event) task-dependence: %lu -> %lu",
+        thread_data->id, src_task_data->id, sink_task_data->id);
+
+    /* The runtime reports a task's edges while creating it, just after its
+       dependences. Only write those which weren't found from last writers,
+       i.e. write-after-read and mutexinoutset/inoutset ordering */
+    data_item_t item = {.value = 0};
+    if (thread_data->dependence_sink == sink_task_data->id
+        && hashmap_find(thread_data->sink_predecessors, src_task_data->id,
+            &item))
+    {
+        return;
+    }
+
+    trace_event_task_dependence(thread_data->location, sink_task_data->id,
+        src_task_data->id, 0, TRACE_DEPENDENCE_RUNTIME);
+    return;
+}
+
 static void
 on_ompt_callback_task_schedule(
     ompt_data_t             *prior_task,
@@ -315,8 +1707,6 @@ on_ompt_callback_task_schedule(
 
     LOG_DEBUG_PRIOR_TASK_STATUS(prior_task_status);
 
-    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
-
     if (prior_task_status == ompt_task_early_fulfill 
         || prior_task_status == ompt_task_late_fulfill)
     {
@@ -331,28 +1721,111 @@ on_ompt_callback_task_schedule(
     prior_task_data = (task_data_t*) prior_task->ptr;
     next_task_data  = (task_data_t*) next_task->ptr;
 
+    /* Neither task is traced */
+    if (prior_task_data == NULL && next_task_data == NULL) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    granularity_task_switch(thread_data->creation);
+
+    /* A thread idle in a sync region was starved until this task switch, and
+       is idle again once it resumes the waiting task */
+    if (next_task_data != NULL && next_task_data->waiting)
+    {
+        begin_idle(thread_data, next_task_data);
+    } else {
+        end_idle(thread_data, true);
+    }
+
     LOG_DEBUG("[t=%lu] (event) task-schedule %lu (%d) -> %lu",
         thread_data->id,
-        prior_task_data->id,
+        prior_task_data ? prior_task_data->id : 0L,
         prior_task_status,
-        next_task_data->id
+        next_task_data ? next_task_data->id : 0L
     );
 
-    if (prior_task_data->type == ompt_task_explicit 
-        || prior_task_data->type == ompt_task_target)
+    if (prior_task_data != NULL && prior_task_status == ompt_task_complete)
+        release_dependence_map(prior_task_data);
+
+    /* Sampled-out and throttled tasks only add their execution time to their
+       ancestor (and parallel region & construct if throttled) */
+    if (prior_task_data != NULL && prior_task_data->region == NULL)
+    {
+        uint64_t time = get_timestamp() - prior_task_data->resume_time;
+        trace_add_untraced_descendants(
+            prior_task_data->traced_ancestor->region, 0, time);
+        trace_sync_region_add_task_time(thread_data->location, time,
+            waiting_for_descendant(thread_data, prior_task_data));
+        if (prior_task_data->throttled)
+        {
+            __sync_fetch_and_add(
+                &prior_task_data->construct->throttled_time, time);
+            if (prior_task_data->parallel != NULL)
+                trace_add_throttled_tasks(
+                    prior_task_data->parallel->region, 0, time);
+        }
+        prior_task_data->exec_time += time;
+        if (prior_task_status == ompt_task_complete)
+            record_task_category_time(prior_task_data);
+    } else if (prior_task_data != NULL
+        && (prior_task_data->type == ompt_task_explicit 
+            || prior_task_data->type == ompt_task_target))
     {
         trace_event_task_schedule(thread_data->location,
             prior_task_data->region, prior_task_status);
         trace_event_leave(thread_data->location);
+        if (prior_task_status == ompt_task_complete)
+            trace_event_task_complete(thread_data->location,
+                prior_task_data->region);
+
+        prior_task_data->exec_time +=
+            get_timestamp() - prior_task_data->resume_time;
+        if (prior_task_status == ompt_task_complete)
+        {
+            record_task_category_time(prior_task_data);
+
+            /* Measure traced tasks of constructs which may be throttled */
+            if (tool_opt->throttle_rate > 0
+                && prior_task_data->construct != NULL)
+            {
+                record_task_completion(thread_data, prior_task_data);
+            }
+        }
+    }
+
+    /* A completed task's lineage is freed once its descendants' are too */
+    if (prior_task_data != NULL && prior_task_status == ompt_task_complete)
+    {
+        task_lineage_release(prior_task_data->lineage);
+        prior_task_data->lineage = NULL;
     }
 
-    if (next_task_data->type == ompt_task_explicit 
-        || next_task_data->type == ompt_task_target)
+    if (next_task_data != NULL && !next_task_data->started
+        && (next_task_data->type == ompt_task_explicit
+            || next_task_data->type == ompt_task_target))
     {
+        record_task_start(thread_data, next_task_data);
+    }
+
+    if (next_task_data != NULL && next_task_data->region == NULL)
+    {
+        next_task_data->resume_time = get_timestamp();
+    } else if (next_task_data != NULL
+        && (next_task_data->type == ompt_task_explicit 
+            || next_task_data->type == ompt_task_target))
+    {
+        next_task_data->resume_time = get_timestamp();
+
         /* reset status on task-entry */
-        trace_event_task_schedule(thread_data->location,
-            prior_task_data->region, 0); /* no status */
+        if (prior_task_data != NULL && prior_task_data->region != NULL)
+            trace_event_task_schedule(thread_data->location,
+                prior_task_data->region, 0); /* no status */
+        trace_event_task_switch(thread_data->location, next_task_data->region);
+        trace_sync_region_set_descendant(thread_data->location,
+            waiting_for_descendant(thread_data, next_task_data));
         trace_event_enter(thread_data->location, next_task_data->region);
+    } else if (next_task_data != NULL) {
+        /* Resuming the implicit or initial task */
+        trace_event_task_switch(thread_data->location, next_task_data->region);
     }
     
     return;
@@ -369,6 +1842,25 @@ on_ompt_callback_implicit_task(
 {
     thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
 
+    /* Threads in every team are counted, whether or not it is traced */
+    unsigned int live_threads = (flags & ompt_task_implicit) ?
+        update_live_threads(thread_data, endpoint) : 0;
+
+    /* Implicit tasks of an untraced or sampled-out parallel region are not
+       traced */
+    if (endpoint == ompt_scope_begin)
+    {
+        parallel_data_t *parallel_data = (flags & ompt_task_implicit) ?
+            (parallel_data_t*) parallel->ptr : NULL;
+        if (parallel_data != NULL)
+            record_team_member(parallel_data, index, actual_parallelism,
+                live_threads);
+        if ((flags & ompt_task_implicit)
+            && (parallel_data == NULL || !parallel_data->traced)) return;
+    } else {
+        if (task->ptr == NULL) return;
+    }
+
     /* Only handle implicit-task events */
     // if (!(flags & ompt_task_implicit)) return;
 
@@ -400,15 +1892,35 @@ on_ompt_callback_implicit_task(
                 parallel_data->encountering_task_data->region : NULL,
             get_unique_task_id(),
             flags,
-            0);
+            0,
+            0,
+            NULL,
+            NULL,
+            CALLSTACK_NONE);
+        implicit_task_data->parallel = parallel_data;
+        if (LINEAGE_NEEDED(tool_opt))
+            implicit_task_data->lineage = new_task_lineage(NULL, 0);
         task->ptr = implicit_task_data;
 
+        /* The thread is ranked by its index in the team for OTF2 task events */
+        implicit_task_data->outer_team_rank = thread_data->team_rank;
+        if (flags & ompt_task_implicit)
+        {
+            thread_data->team_rank = index;
+            trace_add_team_member(parallel_data->region, index,
+                actual_parallelism, live_threads, thread_data->location);
+            trace_set_task_identity(implicit_task_data->region,
+                parallel_data->region, index, 0);
+        }
+
         /* Enter implicit task region */
         trace_event_enter(thread_data->location, implicit_task_data->region);
+        if (flags & ompt_task_implicit) sample_noise(thread_data);
 
     } else {
 
         task_data_t *implicit_task_data = (task_data_t*)task->ptr;
+        if (flags & ompt_task_implicit) sample_noise(thread_data);
 
         /* Update implicit task status */
         trace_event_task_schedule(thread_data->location,
@@ -422,6 +1934,12 @@ on_ompt_callback_implicit_task(
         if (index != 0 && (flags & ompt_task_implicit))
             trace_event_leave(thread_data->location);
 
+        thread_data->team_rank = implicit_task_data->outer_team_rank;
+
+        release_dependence_map(implicit_task_data);
+        task_lineage_release(implicit_task_data->lineage);
+        implicit_task_data->lineage = NULL;
+
         /* For initial-task-end event, must manually record region defintion
            as it never gets handed off to an enclosing parallel region to be
            written at parallel-end */
@@ -455,20 +1973,42 @@ on_ompt_callback_work(
     uint64_t                 count,
     const void              *codeptr_ra)
 {
-    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
     task_data_t *task_data = (task_data_t*) task->ptr;
+    if (task_data == NULL) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
 
     LOG_DEBUG_WORK_TYPE(thread_data->id, wstype, count,
         endpoint==ompt_scope_begin?"begin":"end");
 
+    /* A taskloop's iterations are shared by the tasks it creates, which have
+       the same code address */
+    if (wstype == ompt_work_taskloop && endpoint == ompt_scope_begin)
+    {
+        construct_data_t *construct = get_construct_data(codeptr_ra);
+        if (construct != NULL)
+            __sync_fetch_and_add(&construct->taskloop_iterations, count);
+    }
+
     if (wstype != ompt_work_workshare && wstype != ompt_work_distribute)
     {
         if (endpoint == ompt_scope_begin)
         {
+            if (!REGION_BEGIN_TRACED(task_data, codeptr_ra))
+            {
+                task_data->untraced_depth++;
+                return;
+            }
             trace_region_def_t *wshare_rgn = trace_new_workshare_region(
-                thread_data->location, wstype, count, task_data->id);
+                thread_data->location, wstype, count, task_data->id,
+                codeptr_ra);
             trace_event_enter(thread_data->location, wshare_rgn);
         } else {
+            if (task_data->untraced_depth > 0)
+            {
+                task_data->untraced_depth--;
+                return;
+            }
             trace_event_leave(thread_data->location);
         }
     }
@@ -476,6 +2016,48 @@ on_ompt_callback_work(
     return;
 }
 
+/* Dispatched when a thread is given a loop chunk, iteration or section of the
+   workshare region it is executing */
+static void
+on_ompt_callback_dispatch(
+    ompt_data_t             *parallel,
+    ompt_data_t             *task,
+    ompt_dispatch_t          kind,
+    ompt_data_t              instance)
+{
+    task_data_t *task_data = (task_data_t*) task->ptr;
+    if (task_data == NULL || task_data->region == NULL
+        || task_data->untraced_depth > 0) return;
+
+    uint64_t start = 0, iterations = 1;
+    const otter_dispatch_chunk_t *chunk = NULL;
+    switch ((int) kind)
+    {
+        case ompt_dispatch_iteration:
+        case ompt_dispatch_section:     /* value is the section's address */
+            start = instance.value;
+            break;
+        case OTTER_DISPATCH_WS_LOOP_CHUNK:
+        case OTTER_DISPATCH_TASKLOOP_CHUNK:
+        case OTTER_DISPATCH_DISTRIBUTE_CHUNK:
+            chunk = instance.ptr;
+            start = chunk->start;
+            iterations = chunk->iterations;
+            break;
+        default:
+            LOG_DEBUG("unknown dispatch kind %d", kind);
+            return;
+    }
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    LOG_DEBUG("[t=%lu] (event) dispatch %lu+%lu",
+        thread_data->id, start, iterations);
+
+    trace_workshare_dispatch(thread_data->location, start, iterations,
+        tool_opt->dispatch == otter_dispatch_chunks);
+    return;
+}
+
 /* Used for callbacks that are dispatched when master regions start and end.
 
     NOTE: deprecated in 5.1 and replaced with ompt_callback_masked
@@ -491,18 +2073,30 @@ on_ompt_callback_master(
     ompt_data_t             *task,
     const void              *codeptr_ra)
 {
-    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
     task_data_t *task_data = (task_data_t*) task->ptr;
+    if (task_data == NULL) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
 
     LOG_DEBUG("[t=%lu] (event) master-%s", 
         thread_data->id, endpoint==ompt_scope_begin?"begin":"end");
 
     if (endpoint == ompt_scope_begin)
     {
+        if (!REGION_BEGIN_TRACED(task_data, codeptr_ra))
+        {
+            task_data->untraced_depth++;
+            return;
+        }
         trace_region_def_t *master_rgn = trace_new_master_region(
-            thread_data->location, task_data->id);
+            thread_data->location, task_data->id, codeptr_ra);
         trace_event_enter(thread_data->location, master_rgn);
     } else {
+        if (task_data->untraced_depth > 0)
+        {
+            task_data->untraced_depth--;
+            return;
+        }
         trace_event_leave(thread_data->location);
     }
 
@@ -517,8 +2111,11 @@ on_ompt_callback_sync_region(
     ompt_data_t             *task,
     const void              *codeptr_ra)
 {
-    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
     task_data_t *task_data = (task_data_t*) task->ptr;
+    if (task_data == NULL) return;
+    if (!sync_region_included(kind)) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
 
     LOG_DEBUG("[t=%lu] (event) sync-region-%s (%s)",
         thread_data->id, endpoint == ompt_scope_begin ? "begin" : "end",
@@ -540,15 +2137,91 @@ on_ompt_callback_sync_region(
 
     if (endpoint == ompt_scope_begin)
     {
+        if ((task_data->type & ompt_task_implicit)
+            && task_data->parallel != NULL
+            && kind != ompt_sync_region_taskwait
+            && kind != ompt_sync_region_taskgroup
+            && kind != ompt_sync_region_reduction)
+        {
+            record_barrier_arrival(task_data, codeptr_ra);
+        }
+        if (!REGION_BEGIN_TRACED(task_data, codeptr_ra))
+        {
+            task_data->untraced_depth++;
+            return;
+        }
         trace_region_def_t *sync_rgn = trace_new_sync_region(
-            thread_data->location, kind, task_data->id);
+            thread_data->location, kind, task_data->id, codeptr_ra);
         trace_event_enter(thread_data->location, sync_rgn);
+        if (kind == ompt_sync_region_taskwait
+            || kind == ompt_sync_region_taskgroup)
+        {
+            stack_push(thread_data->waiting_tasks,
+                (data_item_t) {.ptr = task_data});
+        }
     } else {
+        if (task_data->untraced_depth > 0)
+        {
+            task_data->untraced_depth--;
+            return;
+        }
         trace_event_leave(thread_data->location);
+        if (kind == ompt_sync_region_taskwait
+            || kind == ompt_sync_region_taskgroup)
+        {
+            data_item_t item = {.ptr = NULL};
+            stack_pop(thread_data->waiting_tasks, &item);
+        }
     }
     return;
 }
 
+/* Dispatched within a sync region while the thread waits, which may include
+   executing tasks at the region's scheduling points */
+static void
+on_ompt_callback_sync_region_wait(
+    ompt_sync_region_t       kind,
+    ompt_scope_endpoint_t    endpoint,
+    ompt_data_t             *parallel,
+    ompt_data_t             *task,
+    const void              *codeptr_ra)
+{
+    task_data_t *task_data = (task_data_t*) task->ptr;
+    if (task_data == NULL) return;
+    if (!sync_region_included(kind)) return;
+
+    thread_data_t *thread_data = (thread_data_t*) get_thread_data()->ptr;
+    LOG_DEBUG("[t=%lu] (event) sync-region-wait-%s", thread_data->id,
+        endpoint == ompt_scope_begin ? "begin" : "end");
+
+    /* Idle time counts towards starvation whether or not the region is
+       traced */
+    task_data->waiting = endpoint == ompt_scope_begin;
+    if (endpoint == ompt_scope_begin)
+    {
+        begin_idle(thread_data, task_data);
+    } else {
+        end_idle(thread_data, false);
+    }
+    if (task_data->region == NULL || task_data->untraced_depth > 0) return;
+
+    trace_sync_region_wait(thread_data->location, endpoint);
+    return;
+}
+
+/* Barriers and other synchronisation share the sync region callbacks, so
+   filter by kind. Both endpoints of a region have the same kind. Every kind
+   other than these is some form of barrier (see OpenMP 5.1 sec. 19.4.4.13) */
+static bool
+sync_region_included(ompt_sync_region_t kind)
+{
+    bool is_barrier = kind != ompt_sync_region_taskwait
+        && kind != ompt_sync_region_taskgroup
+        && kind != ompt_sync_region_reduction;
+    return tool_opt->events &
+        (is_barrier ? otter_event_barrier : otter_event_sync);
+}
+
 unique_id_t
 get_unique_id(unique_id_type_t id_type)
 {
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fnmatch.h>
+
+#include <macros/debug.h>
+#include <otter-core/otter-filter.h>
+#include <otter-trace/trace-symbols.h>
+#include <otter-datatypes/hashmap.h>
+
+/* Maximum number of distinct constructs filtered */
+#define FILTER_CACHE_CAPACITY 8192
+
+/* Cached decisions. Items must be non-zero */
+#define FILTER_INCLUDE 1
+#define FILTER_EXCLUDE 2
+
+typedef enum {
+    filter_by_function,
+    filter_by_file,
+    filter_by_address
+} filter_kind_t;
+
+typedef struct filter_rule_t {
+    bool            include;
+    filter_kind_t   kind;
+    char           *pattern;        // function or file glob
+    unsigned int    first_line;     // file rules only (0 = any line)
+    unsigned int    last_line;
+    uintptr_t       start;          // address rules only
+    uintptr_t       end;
+} filter_rule_t;
+
+static filter_rule_t *rules = NULL;
+static size_t         n_rules = 0;
+static bool           need_line = false;   // any rules match source files
+static hashmap_t     *decisions = NULL;
+
+static bool parse_rule(char *line, filter_rule_t *rule);
+static bool rule_matches(filter_rule_t *rule, const symbol_info_t *sym);
+
+bool
+filter_initialise(const char *path)
+{
+    if (path == NULL) return true;
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        LOG_ERROR("failed to open filter file \"%s\"", path);
+        return false;
+    }
+
+    char line[1024] = {0};
+    unsigned int lineno = 0;
+    size_t capacity = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        lineno++;
+        line[strcspn(line, "#\n")] = '\0';
+        if (strspn(line, " \t") == strlen(line)) continue;
+
+        if (n_rules == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 16;
+            rules = realloc(rules, capacity * sizeof(*rules));
+        }
+
+        if (!parse_rule(line, &rules[n_rules]))
+        {
+            LOG_ERROR("%s:%u: invalid filter rule", path, lineno);
+            ok = false;
+            continue;
+        }
+        if (rules[n_rules].kind == filter_by_file) need_line = true;
+        n_rules++;
+    }
+    fclose(file);
+
+    LOG_INFO("read %lu filter rules from %s", n_rules, path);
+
+    if (n_rules > 0)
+    {
+        decisions = hashmap_create(FILTER_CACHE_CAPACITY);
+    }
+
+    /* Constructs are filtered inside callbacks, where only the executable's
+       lines can be looked up */
+    if (need_line) symbols_resolve_executable();
+    return ok;
+}
+
+void
+filter_finalise(void)
+{
+    if (n_rules == 0) return;
+    for (size_t k=0; k<n_rules; k++) free(rules[k].pattern);
+    free(rules);
+    rules = NULL;
+    n_rules = 0;
+    hashmap_destroy(decisions, false, NULL);
+    return;
+}
+
+bool
+filter_include(const void *codeptr_ra)
+{
+    if (n_rules == 0) return true;
+
+    data_item_t item = {.value = 0};
+    if (hashmap_find(decisions, (uint64_t) codeptr_ra, &item))
+        return item.value == FILTER_INCLUDE;
+
+    /* First encounter: apply each rule in turn, the last match wins */
+    const symbol_info_t *sym = symbols_lookup(codeptr_ra, need_line);
+    bool include = true;
+    for (size_t k=0; k<n_rules; k++)
+        if (rule_matches(&rules[k], sym)) include = rules[k].include;
+
+    LOG_DEBUG("%s %p", include ? "include" : "exclude", codeptr_ra);
+
+    hashmap_insert(decisions, (uint64_t) codeptr_ra,
+        (data_item_t) {.value = include ? FILTER_INCLUDE : FILTER_EXCLUDE});
+    return include;
+}
+
+static bool
+parse_rule(char *line, filter_rule_t *rule)
+{
+    char action[16] = {0}, kind[16] = {0}, pattern[1000] = {0};
+    if (sscanf(line, " %15s %15s %999s", action, kind, pattern) != 3)
+        return false;
+
+    *rule = (filter_rule_t) {
+        .include    = true,
+        .kind       = filter_by_function,
+        .pattern    = NULL,
+        .first_line = 0,
+        .last_line  = 0,
+        .start      = 0,
+        .end        = 0
+    };
+
+    if      (!strcmp(action, "include")) rule->include = true;
+    else if (!strcmp(action, "exclude")) rule->include = false;
+    else return false;
+
+    if (!strcmp(kind, "function"))
+    {
+        rule->kind = filter_by_function;
+    } else if (!strcmp(kind, "file")) {
+        rule->kind = filter_by_file;
+        char *colon = strrchr(pattern, ':');
+        if (colon != NULL)
+        {
+            *colon = '\0';
+            int n = sscanf(colon + 1, "%u-%u",
+                &rule->first_line, &rule->last_line);
+            if (n < 1) return false;
+            if (n == 1) rule->last_line = rule->first_line;
+        }
+    } else if (!strcmp(kind, "address")) {
+        rule->kind = filter_by_address;
+        int n = sscanf(pattern, "%lx-%lx", &rule->start, &rule->end);
+        if (n < 1) return false;
+        if (n == 1) rule->end = rule->start;
+        return true;
+    } else {
+        return false;
+    }
+
+    rule->pattern = strdup(pattern);
+    return true;
+}
+
+static bool
+rule_matches(filter_rule_t *rule, const symbol_info_t *sym)
+{
+    if (sym == NULL) return false;
+
+    /* another thread's lookup may publish the function name & file, which
+       is stored after the line */
+    const char *function = __atomic_load_n(&sym->function, __ATOMIC_ACQUIRE);
+    const char *file = __atomic_load_n(&sym->file, __ATOMIC_ACQUIRE);
+
+    switch (rule->kind)
+    {
+    case filter_by_function:
+        return function != NULL && fnmatch(rule->pattern, function, 0) == 0;
+
+    case filter_by_file:
+        if (file == NULL) return false;
+        if (rule->first_line > 0
+            && (sym->line < rule->first_line || sym->line > rule->last_line))
+            return false;
+        /* a pattern without a directory also matches the file's basename */
+        if (fnmatch(rule->pattern, file, 0) == 0) return true;
+        if (strchr(rule->pattern, '/') == NULL)
+        {
+            const char *base = strrchr(file, '/');
+            return base != NULL && fnmatch(rule->pattern, base + 1, 0) == 0;
+        }
+        return false;
+
+    case filter_by_address:
+        return (uintptr_t) sym->addr >= rule->start
+            && (uintptr_t) sym->addr <= rule->end;
+    }
+    return false;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <macros/debug.h>
+#include <otter-core/otter-granularity.h>
+#include <otter-core/otter-structs.h>
+#include <otter-trace/trace.h>
+#include <otter-trace/trace-symbols.h>
+#include <otter-datatypes/histogram.h>
+
+struct creation_stats_t {
+    uint64_t        last_time;          // end of the last task-create callback,
+                                        // 0 after a switch
+    unique_id_t     last_creator;
+    uint64_t        intervals[CREATION_COST_BINS];
+    uint64_t        interval_time[CREATION_COST_BINS];      // ns
+};
+
+/* Intervals of ended threads */
+static creation_stats_t merged = {0};
+static pthread_mutex_t lock_merged = PTHREAD_MUTEX_INITIALIZER;
+
+/* Tasks should take at least this many times the cost of creating one */
+static unsigned int cost_multiple = 0;
+
+static uint64_t creation_cost(void);
+static void print_construct(const construct_data_t *construct,
+    uint64_t threshold);
+
+void
+granularity_initialise(unsigned int multiple)
+{
+    cost_multiple = multiple;
+    return;
+}
+
+creation_stats_t *
+granularity_new_stats(void)
+{
+    return calloc(1, sizeof(creation_stats_t));
+}
+
+void
+granularity_merge_stats(creation_stats_t *stats)
+{
+    if (stats == NULL) return;
+    pthread_mutex_lock(&lock_merged);
+    int k=0;
+    for (k=0; k<CREATION_COST_BINS; k++)
+    {
+        merged.intervals[k] += stats->intervals[k];
+        merged.interval_time[k] += stats->interval_time[k];
+    }
+    pthread_mutex_unlock(&lock_merged);
+    free(stats);
+    return;
+}
+
+void
+granularity_task_created(
+    creation_stats_t   *stats,
+    unique_id_t         creator,
+    uint64_t            callback_begin,
+    uint64_t            callback_end)
+{
+    if (stats == NULL) return;
+    if (stats->last_time != 0 && stats->last_creator == creator
+        && callback_begin > stats->last_time)
+    {
+        uint64_t interval = callback_begin - stats->last_time;
+        unsigned int bin = histogram_bin(interval, CREATION_COST_BINS);
+        stats->intervals[bin]++;
+        stats->interval_time[bin] += interval;
+    }
+    stats->last_time = callback_end;
+    stats->last_creator = creator;
+    return;
+}
+
+void
+granularity_task_switch(creation_stats_t *stats)
+{
+    if (stats == NULL) return;
+    stats->last_time = 0;
+    return;
+}
+
+void
+granularity_print_summary(void)
+{
+    uint64_t cost = creation_cost();
+    uint64_t threshold = cost * cost_multiple;
+
+    construct_data_t *construct = NULL;
+    size_t next = 0;
+    bool header = false;
+    while (construct_scan(&construct, &next))
+    {
+        int d=0;
+        uint64_t tasks = 0;
+        for (d=0; d<TASK_DEPTH_BINS; d++) tasks += construct->depth_tasks[d];
+        if (tasks == 0) continue;
+        if (!header)
+        {
+            fprintf(stderr, "\nTASK GRANULARITY (creation cost ~%lu ns "
+                "excluding Otter's task-create callback, tasks should take "
+                "at least %lu ns):\n", cost, threshold);
+            fprintf(stderr, "%18s %12s %8s %12s %12s %8s %12s %12s  %s\n",
+                "construct", "tasks", "depths", "mean (us)", "fine from",
+                "cutoff", "grainsize", "suggested", "location");
+            header = true;
+        }
+        print_construct(construct, threshold);
+    }
+}
+
+/* The typical interval between back-to-back task creations: the mean of the
+   intervals in the bin containing the median. Excludes Otter's task-create
+   callback, though not any other tool overhead between the creations */
+static uint64_t
+creation_cost(void)
+{
+    pthread_mutex_lock(&lock_merged);
+    uint64_t total = 0, count = 0, cost = 0;
+    int k=0;
+    for (k=0; k<CREATION_COST_BINS; k++) total += merged.intervals[k];
+    for (k=0; k<CREATION_COST_BINS && total > 0; k++)
+    {
+        count += merged.intervals[k];
+        if (2 * count >= total)
+        {
+            cost = merged.interval_time[k] / merged.intervals[k];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock_merged);
+    return cost;
+}
+
+/* Tasks are too fine from the shallowest depth whose tasks, including their
+   descendants, take less than the threshold on average. Tasks beyond the
+   depth above that (the cutoff) should be included, e.g. with a final()
+   clause. A cutoff of 0 means that the construct's tasks are always too
+   fine. A taskloop's grainsize is chosen so its tasks just reach the
+   threshold */
+static void
+print_construct(const construct_data_t *construct, uint64_t threshold)
+{
+    uint64_t tasks = 0, time = 0;
+    int d = 0, deepest = 0, fine = 0;
+    for (d=0; d<TASK_DEPTH_BINS; d++)
+    {
+        uint64_t n = construct->depth_tasks[d];
+        if (n == 0) continue;
+        tasks += n;
+        time += construct->depth_time[d];
+        deepest = d;
+        if (fine == 0 && threshold > 0 && construct->depth_time[d] / n < threshold)
+            fine = d;
+    }
+
+    char fine_str[16] = "-", cutoff_str[16] = "-";
+    if (fine > 0)
+    {
+        snprintf(fine_str, sizeof(fine_str), "%d", fine);
+        snprintf(cutoff_str, sizeof(cutoff_str), "%d", fine - 1);
+    }
+
+    /* Only the time of the taskloop's tasks themselves is spread over its
+       iterations */
+    char grain_str[24] = "-", suggested_str[24] = "-";
+    if (construct->taskloop_iterations > 0)
+    {
+        snprintf(grain_str, sizeof(grain_str), "%.1f",
+            (double) construct->taskloop_iterations / tasks);
+        double iteration_cost =
+            (double) time / construct->taskloop_iterations;
+        if (threshold > 0 && iteration_cost > 0.0)
+        {
+            uint64_t grainsize = (uint64_t) (threshold / iteration_cost + 0.5);
+            snprintf(suggested_str, sizeof(suggested_str), "%lu",
+                grainsize > 0 ? grainsize : 1);
+        }
+    }
+
+    const symbol_info_t *sym = symbols_lookup(construct->codeptr_ra, false);
+    fprintf(stderr, "%18p %12lu %8d %12.3f %12s %8s %12s %12s  %s\n",
+        construct->codeptr_ra,
+        tasks,
+        deepest,
+        time / 1e3 / tasks,
+        fine_str,
+        cutoff_str,
+        grain_str,
+        suggested_str,
+        sym && sym->function ? sym->function : "?");
+    return;
+}
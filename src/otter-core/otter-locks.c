@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <macros/debug.h>
+#include <otter-core/otter-locks.h>
+#include <otter-trace/trace.h>
+#include <otter-trace/trace-symbols.h>
+#include <otter-datatypes/hashmap.h>
+#include <otter-datatypes/histogram.h>
+
+/* Maximum number of distinct (wait_id, codeptr_ra) pairs per table */
+#define LOCK_TABLE_CAPACITY 1024
+
+/* Maximum number of mutexes a thread may hold at once */
+#define LOCK_MAX_HELD 16
+
+/* Keys tried for a pair before giving up, in case two pairs hash alike */
+#define LOCK_KEY_PROBES 4
+
+/* Maximum number of locks whose initialisation site is recorded */
+#define LOCK_SITE_CAPACITY 4096
+
+/* A mutex currently held by the thread */
+typedef struct lock_held_t {
+    ompt_wait_id_t  wait_id;
+    lock_stats_t   *stats;
+    uint64_t        acquired_time;
+    uint64_t        wait_time;
+} lock_held_t;
+
+struct lock_table_t {
+    hashmap_t      *stats;              // key -> lock_stats_t*
+    uint64_t        acquire_time;       // of the pending acquisition
+    lock_held_t     held[LOCK_MAX_HELD];
+    unsigned int    n_held;
+    uint64_t        dropped;            // acquisitions not recorded
+};
+
+/* Process-wide table, only touched when a thread's table is merged */
+static lock_table_t *merged = NULL;
+static pthread_mutex_t lock_merged = PTHREAD_MUTEX_INITIALIZER;
+
+/* Initialisation site of each lock, keyed by wait_id */
+static hashmap_t *lock_sites = NULL;
+
+static lock_stats_t *find_stats(lock_table_t *table, ompt_mutex_t kind,
+    ompt_wait_id_t wait_id, const void *codeptr_ra);
+static int compare_wait_time(const void *a, const void *b);
+static const char *mutex_kind_name(ompt_mutex_t kind);
+
+void
+locks_initialise(void)
+{
+    merged = locks_new_table();
+    lock_sites = hashmap_create(LOCK_SITE_CAPACITY);
+    return;
+}
+
+void
+locks_finalise(void)
+{
+    if (merged == NULL) return;
+    hashmap_destroy(merged->stats, true, NULL);
+    free(merged);
+    merged = NULL;
+    hashmap_destroy(lock_sites, false, NULL);
+    lock_sites = NULL;
+    return;
+}
+
+lock_table_t *
+locks_new_table(void)
+{
+    lock_table_t *table = malloc(sizeof(*table));
+    *table = (lock_table_t) {
+        .stats        = hashmap_create(LOCK_TABLE_CAPACITY),
+        .acquire_time = 0,
+        .n_held       = 0,
+        .dropped      = 0
+    };
+    return table;
+}
+
+void
+locks_merge_table(lock_table_t *table)
+{
+    if (table == NULL) return;
+
+    pthread_mutex_lock(&lock_merged);
+    uint64_t key = 0;
+    data_item_t item = {.ptr = NULL};
+    size_t next = 0;
+    while (hashmap_scan(table->stats, &key, &item, &next))
+    {
+        lock_stats_t *src = item.ptr;
+        lock_stats_t *dst = find_stats(merged,
+            src->kind, src->wait_id, src->codeptr_ra);
+        if (dst == NULL)
+        {
+            merged->dropped += src->acquisitions;
+            continue;
+        }
+        dst->acquisitions += src->acquisitions;
+        dst->contended    += src->contended;
+        dst->wait_time    += src->wait_time;
+        dst->hold_time    += src->hold_time;
+        if (src->max_wait > dst->max_wait) dst->max_wait = src->max_wait;
+        if (src->max_hold > dst->max_hold) dst->max_hold = src->max_hold;
+        int k=0;
+        for (k=0; k<LOCK_HISTOGRAM_BINS; k++)
+        {
+            dst->wait_histogram[k] += src->wait_histogram[k];
+            dst->hold_histogram[k] += src->hold_histogram[k];
+        }
+    }
+    merged->dropped += table->dropped;
+    pthread_mutex_unlock(&lock_merged);
+
+    LOG_WARN_IF((table->n_held > 0),
+        "thread ended holding %u mutexes", table->n_held);
+
+    hashmap_destroy(table->stats, true, NULL);
+    free(table);
+    return;
+}
+
+void
+locks_record_init(ompt_wait_id_t wait_id, const void *codeptr_ra)
+{
+    if (codeptr_ra == NULL) return;
+    hashmap_exchange(lock_sites, wait_id,
+        (data_item_t) {.ptr = (void*) codeptr_ra});
+    return;
+}
+
+void
+locks_acquire(lock_table_t *table)
+{
+    table->acquire_time = get_timestamp();
+    return;
+}
+
+uint64_t
+locks_acquired(
+    lock_table_t    *table,
+    ompt_mutex_t     kind,
+    ompt_wait_id_t   wait_id,
+    const void      *codeptr_ra)
+{
+    uint64_t now = get_timestamp();
+    uint64_t wait = table->acquire_time ? now - table->acquire_time : 0;
+    table->acquire_time = 0;
+
+    lock_stats_t *stats = find_stats(table, kind, wait_id, codeptr_ra);
+    if (stats == NULL || table->n_held == LOCK_MAX_HELD)
+    {
+        table->dropped++;
+        return wait;
+    }
+
+    stats->acquisitions++;
+    if (wait >= LOCK_CONTENDED_THRESHOLD) stats->contended++;
+    stats->wait_time += wait;
+    if (wait > stats->max_wait) stats->max_wait = wait;
+    histogram_add(stats->wait_histogram, LOCK_HISTOGRAM_BINS, wait);
+
+    table->held[table->n_held++] = (lock_held_t) {
+        .wait_id       = wait_id,
+        .stats         = stats,
+        .acquired_time = now,
+        .wait_time     = wait
+    };
+    return wait;
+}
+
+const lock_stats_t *
+locks_released(
+    lock_table_t    *table,
+    ompt_wait_id_t   wait_id,
+    uint64_t        *wait_time,
+    uint64_t        *hold_time)
+{
+    /* Mutexes are usually released in the reverse order of acquisition */
+    int k = (int) table->n_held - 1;
+    while (k >= 0 && table->held[k].wait_id != wait_id) k--;
+    if (k < 0) return NULL;
+
+    lock_held_t held = table->held[k];
+    memmove(&table->held[k], &table->held[k+1],
+        (table->n_held - k - 1) * sizeof(lock_held_t));
+    table->n_held--;
+
+    uint64_t hold = get_timestamp() - held.acquired_time;
+    held.stats->hold_time += hold;
+    if (hold > held.stats->max_hold) held.stats->max_hold = hold;
+    histogram_add(held.stats->hold_histogram, LOCK_HISTOGRAM_BINS, hold);
+
+    *wait_time = held.wait_time;
+    *hold_time = hold;
+    return held.stats;
+}
+
+void
+locks_print_summary(void)
+{
+    if (merged == NULL) return;
+
+    size_t n = hashmap_size(merged->stats), k = 0;
+    lock_stats_t **sorted = malloc((n + 1) * sizeof(*sorted));
+    uint64_t key = 0;
+    data_item_t item = {.ptr = NULL};
+    size_t next = 0;
+    while (k < n && hashmap_scan(merged->stats, &key, &item, &next))
+        sorted[k++] = item.ptr;
+    n = k;
+    qsort(sorted, n, sizeof(*sorted), compare_wait_time);
+
+    fprintf(stderr, "\nMUTEX CONTENTION (top %d by wait time):\n",
+        LOCK_REPORT_TOP);
+    fprintf(stderr, "%-14s %18s %12s %12s %12s %10s %10s %12s  %s\n",
+        "kind", "wait_id", "acquired", "contended", "wait (ms)",
+        "p50 (ns)", "p99 (ns)", "held (ms)", "location");
+    for (k=0; k<n && k<LOCK_REPORT_TOP; k++)
+    {
+        lock_stats_t *s = sorted[k];
+        if (s->wait_time == 0) break;
+
+        /* Locks are named by the call which initialised them, if known */
+        const void *site = s->codeptr_ra;
+        data_item_t init = {.ptr = NULL};
+        if (hashmap_find(lock_sites, s->wait_id, &init)) site = init.ptr;
+        const symbol_info_t *sym = symbols_lookup(site, false);
+
+        fprintf(stderr, "%-14s %#18lx %12lu %12lu %12.3f %10lu %10lu %12.3f  "
+            "%s (%p)\n",
+            mutex_kind_name(s->kind),
+            (unsigned long) s->wait_id,
+            s->acquisitions,
+            s->contended,
+            s->wait_time / 1e6,
+            histogram_percentile(s->wait_histogram,
+                LOCK_HISTOGRAM_BINS, 0.50),
+            histogram_percentile(s->wait_histogram,
+                LOCK_HISTOGRAM_BINS, 0.99),
+            s->hold_time / 1e6,
+            sym && sym->function ? sym->function : "?",
+            s->codeptr_ra);
+    }
+    LOG_WARN_IF((merged->dropped > 0),
+        "%lu mutex acquisitions weren't recorded", merged->dropped);
+    free(sorted);
+    return;
+}
+
+/* Get the statistics for a pair, adding them on first use. Returns NULL if the
+   table is full */
+static lock_stats_t *
+find_stats(
+    lock_table_t    *table,
+    ompt_mutex_t     kind,
+    ompt_wait_id_t   wait_id,
+    const void      *codeptr_ra)
+{
+    uint64_t key = (uint64_t) wait_id
+        ^ ((uint64_t) codeptr_ra * 0x9e3779b97f4a7c15ULL);
+    data_item_t item = {.ptr = NULL};
+    int n=0;
+    for (n=0; n<LOCK_KEY_PROBES; n++, key++)
+    {
+        if (hashmap_find(table->stats, key, &item))
+        {
+            lock_stats_t *stats = item.ptr;
+            if (stats->wait_id == wait_id && stats->codeptr_ra == codeptr_ra)
+                return stats;
+            continue;
+        }
+        lock_stats_t *stats = calloc(1, sizeof(*stats));
+        stats->kind       = kind;
+        stats->wait_id    = wait_id;
+        stats->codeptr_ra = codeptr_ra;
+        item = hashmap_insert(table->stats, key, (data_item_t) {.ptr = stats});
+        if (item.ptr != stats) free(stats);
+        return item.ptr;
+    }
+    return NULL;
+}
+
+/* Sort by descending total wait time */
+static int
+compare_wait_time(const void *a, const void *b)
+{
+    const lock_stats_t *x = *(lock_stats_t * const *) a;
+    const lock_stats_t *y = *(lock_stats_t * const *) b;
+    return (x->wait_time < y->wait_time) - (x->wait_time > y->wait_time);
+}
+
+static const char *
+mutex_kind_name(ompt_mutex_t kind)
+{
+    switch (kind)
+    {
+        case ompt_mutex_lock:           return "lock";
+        case ompt_mutex_test_lock:      return "test_lock";
+        case ompt_mutex_nest_lock:      return "nest_lock";
+        case ompt_mutex_test_nest_lock: return "test_nest_lock";
+        case ompt_mutex_critical:       return "critical";
+        case ompt_mutex_atomic:         return "atomic";
+        case ompt_mutex_ordered:        return "ordered";
+        default:                        return "?";
+    }
+}
@@ -0,0 +1,173 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <macros/debug.h>
+#include <otter-core/otter-noise.h>
+
+struct noise_stats_t {
+    uint64_t        thread_id;
+    int             schedstat_fd;       // -1 if unavailable or closed
+    bool            has_wait_time;
+    uint64_t        samples;
+    uint64_t        preempted;          // samples after a preemption
+    uint64_t        last_preemptions;   // cumulative at the last sample
+    uint64_t        last_wait_time;     // ns, cumulative at the last sample
+    uint64_t        first_preemptions;
+    uint64_t        first_wait_time;
+    uint64_t        migrations;
+    noise_stats_t  *next;               // in the process-wide table
+};
+
+/* Stats of ended threads, in the order they ended */
+static noise_stats_t *merged = NULL;
+static pthread_mutex_t lock_merged = PTHREAD_MUTEX_INITIALIZER;
+
+static bool read_wait_time(int fd, uint64_t *wait_time);
+static bool read_preemptions(uint64_t *preemptions);
+
+void
+noise_finalise(void)
+{
+    pthread_mutex_lock(&lock_merged);
+    while (merged != NULL)
+    {
+        noise_stats_t *next = merged->next;
+        free(merged);
+        merged = next;
+    }
+    pthread_mutex_unlock(&lock_merged);
+    return;
+}
+
+void
+noise_print_summary(void)
+{
+    pthread_mutex_lock(&lock_merged);
+    fprintf(stderr, "\nOS NOISE (per thread):\n");
+    fprintf(stderr, "%8s %10s %10s %12s %16s %12s\n",
+        "thread", "samples", "preempted", "preemptions", "runqueue (ms)",
+        "migrations");
+    noise_stats_t *s = NULL;
+    for (s = merged; s != NULL; s = s->next)
+    {
+        fprintf(stderr, "%8lu %10lu %10lu %12lu ",
+            s->thread_id,
+            s->samples,
+            s->preempted,
+            s->last_preemptions - s->first_preemptions);
+        if (s->has_wait_time)
+            fprintf(stderr, "%16.3f",
+                (s->last_wait_time - s->first_wait_time) / 1e6);
+        else
+            fprintf(stderr, "%16s", "-");
+        fprintf(stderr, " %12lu\n", s->migrations);
+    }
+    pthread_mutex_unlock(&lock_merged);
+    return;
+}
+
+noise_stats_t *
+noise_new_stats(uint64_t thread_id)
+{
+    char path[64] = {0};
+    snprintf(path, sizeof(path), "/proc/self/task/%ld/schedstat",
+        (long) syscall(SYS_gettid));
+
+    noise_stats_t *stats = malloc(sizeof(*stats));
+    *stats = (noise_stats_t) {
+        .thread_id          = thread_id,
+        .schedstat_fd       = open(path, O_RDONLY | O_CLOEXEC),
+        .has_wait_time      = false,
+        .samples            = 0,
+        .preempted          = 0,
+        .last_preemptions   = 0,
+        .last_wait_time     = 0,
+        .first_preemptions  = 0,
+        .first_wait_time    = 0,
+        .migrations         = 0,
+        .next               = NULL
+    };
+    if (stats->schedstat_fd < 0)
+    {
+        LOG_WARN("run-queue wait time unavailable (%s: %s)",
+            path, strerror(errno));
+        errno = 0;
+    }
+    read_preemptions(&stats->last_preemptions);
+    stats->has_wait_time = read_wait_time(stats->schedstat_fd,
+        &stats->last_wait_time);
+    stats->first_preemptions = stats->last_preemptions;
+    stats->first_wait_time = stats->last_wait_time;
+    return stats;
+}
+
+bool
+noise_sample(noise_stats_t *stats, uint64_t *preemptions, uint64_t *wait_time)
+{
+    /* A failed read keeps the previous value, so nothing is counted until the
+       next successful one */
+    uint64_t now_preemptions = stats->last_preemptions;
+    uint64_t now_wait_time = stats->last_wait_time;
+    read_preemptions(&now_preemptions);
+    if (stats->has_wait_time)
+        read_wait_time(stats->schedstat_fd, &now_wait_time);
+
+    *preemptions = now_preemptions - stats->last_preemptions;
+    *wait_time = now_wait_time - stats->last_wait_time;
+    stats->last_preemptions = now_preemptions;
+    stats->last_wait_time = now_wait_time;
+    stats->samples++;
+    if (*preemptions == 0) return false;
+    stats->preempted++;
+    return true;
+}
+
+void
+noise_merge_stats(noise_stats_t *stats, uint64_t migrations)
+{
+    if (stats == NULL) return;
+    stats->migrations = migrations;
+    if (stats->schedstat_fd >= 0) close(stats->schedstat_fd);
+    stats->schedstat_fd = -1;
+
+    pthread_mutex_lock(&lock_merged);
+    noise_stats_t **tail = &merged;
+    while (*tail != NULL) tail = &(*tail)->next;
+    *tail = stats;
+    pthread_mutex_unlock(&lock_merged);
+    return;
+}
+
+/* The second field of schedstat is the time (ns) spent runnable on a run queue
+   but not running. Returns false, leaving wait_time as it is, if unavailable */
+static bool
+read_wait_time(int fd, uint64_t *wait_time)
+{
+    if (fd < 0) return false;
+    char buf[128] = {0};
+    if (pread(fd, buf, sizeof(buf) - 1, 0) <= 0) return false;
+    unsigned long long run_time = 0, wait = 0;
+    if (sscanf(buf, "%llu %llu", &run_time, &wait) != 2) return false;
+    *wait_time = wait;
+    return true;
+}
+
+static bool
+read_preemptions(uint64_t *preemptions)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) != 0) return false;
+    *preemptions = usage.ru_nivcsw;
+    return true;
+}
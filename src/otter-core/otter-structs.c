@@ -1,10 +1,98 @@
 #include <stdint.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <otter-ompt-header.h>
 #include <otter-core/otter.h>
 #include <otter-core/otter-structs.h>
 #include <otter-trace/trace.h>
 #include <otter-trace/trace-structs.h>
+#include <otter-datatypes/hashmap.h>
+
+/* Constructs encountered, keyed by their code address */
+static hashmap_t *constructs = NULL;
+
+void
+constructs_initialise(void)
+{
+    constructs = hashmap_create(CONSTRUCT_REGISTRY_CAPACITY);
+    return;
+}
+
+void
+constructs_finalise(void)
+{
+    hashmap_destroy(constructs, true, NULL);
+    constructs = NULL;
+    return;
+}
+
+/* Get the data for the construct at codeptr_ra, registering it on first
+   encounter. Returns NULL if the registry is full */
+construct_data_t *
+get_construct_data(const void *codeptr_ra)
+{
+    data_item_t item = {.ptr = NULL};
+    uint64_t key = (uint64_t) codeptr_ra;
+
+    if (hashmap_find(constructs, key, &item)) return item.ptr;
+
+    construct_data_t *new = malloc(sizeof(*new));
+    *new = (construct_data_t) {
+        .codeptr_ra      = codeptr_ra,
+        .instances       = 0,
+        .traced          = 0,
+        .untraced        = 0,
+        .untraced_time   = 0,
+        .pending_skipped = 0,
+        .pending_time    = 0,
+        .first_seen      = get_timestamp(),
+        .tasks           = 0,
+        .task_time       = 0,
+        .throttled       = false,
+        .throttled_tasks = 0,
+        .throttled_time  = 0,
+        .started         = 0,
+        .stolen          = 0,
+        .start_latency   = 0,
+        .queued          = 0,
+        .queued_time     = 0,
+        .latency_histogram = {0},
+        .teams           = 0,
+        .team_shortfall  = 0,
+        .oversubscribed  = 0,
+        .requested       = 0,
+        .min_team        = UINT_MAX,
+        .peak_threads    = 0,
+        .barriers        = 0,
+        .barrier_skew    = 0,
+        .max_barrier_skew = 0,
+        .barrier_wait    = 0,
+        .category_tasks  = {0},
+        .category_time   = {0},
+        .depth_tasks     = {0},
+        .depth_time      = {0},
+        .taskloop_iterations = 0,
+        .producing_regions = 0,
+        .producer_bottlenecks = 0,
+        .producer_time   = 0,
+        .starved_time    = 0
+    };
+
+    /* Another thread may have registered this construct first */
+    item = hashmap_insert(constructs, key, (data_item_t) {.ptr = new});
+    if (item.ptr != new) free(new);
+    return item.ptr;
+}
+
+bool
+construct_scan(construct_data_t **dest, size_t *next)
+{
+    uint64_t key = 0;
+    data_item_t item = {.ptr = NULL};
+    if (!hashmap_scan(constructs, &key, &item, next)) return false;
+    *dest = item.ptr;
+    return true;
+}
 
 parallel_data_t *
 new_parallel_data(
@@ -12,27 +100,69 @@ new_parallel_data(
     unique_id_t  encountering_task_id,
     task_data_t *encountering_task_data,
     unsigned int requested_parallelism,
-    int          flags)
+    int          flags,
+    construct_data_t *construct,
+    bool         traced,
+    const void  *codeptr_ra,
+    uint32_t     callstack_id)
 {
     parallel_data_t *parallel_data = malloc(sizeof(*parallel_data));
     *parallel_data = (parallel_data_t) {
         .id                      = get_unique_parallel_id(),
         .master_thread           = thread_id,
         .encountering_task_data  = encountering_task_data,
-        .region                  = NULL
+        .region                  = NULL,
+        .construct               = construct,
+        .traced                  = traced,
+        .begin_time              = 0,
+        .requested_parallelism   = requested_parallelism,
+        .peak_threads            = 0,
+        .team_size               = 0,
+        .producers               = NULL,
+        .tasks_completed         = 0,
+        .completed_time          = 0,
+        .starved_time            = 0
     };
+    int k=0;
+    for (k=0; k<BARRIER_ARRIVAL_SLOTS; k++)
+        parallel_data->arrivals[k] = (barrier_arrivals_t) {
+            .arrived = 0, .first = UINT64_MAX, .last = 0, .sum = 0};
+
+    if (!traced)
+    {
+        parallel_data->begin_time = get_timestamp();
+        return parallel_data;
+    }
+
+    parallel_data->producers =
+        calloc(requested_parallelism, sizeof(task_producer_t));
+
+    /* Claim the instances sampled out since this construct was last traced */
+    uint64_t skipped = 0, skipped_time = 0;
+    if (construct != NULL)
+    {
+        skipped = __atomic_exchange_n(
+            &construct->pending_skipped, 0, __ATOMIC_RELAXED);
+        skipped_time = __atomic_exchange_n(
+            &construct->pending_time, 0, __ATOMIC_RELAXED);
+    }
 
     parallel_data->region = trace_new_parallel_region(
         parallel_data->id,
         thread_id,
         encountering_task_id,
         flags,
-        requested_parallelism);
+        requested_parallelism,
+        skipped,
+        skipped_time,
+        codeptr_ra,
+        callstack_id);
     return parallel_data;
 }
 
 void parallel_destroy(parallel_data_t *parallel_data)
 {
+    free(parallel_data->producers);
     free(parallel_data);
     return;
 }
@@ -45,7 +175,20 @@ new_thread_data(ompt_thread_t type)
         .id                 = get_unique_thread_id(),
         .location           = NULL,
         .type               = type,
-        .is_master_thread   = false
+        .is_master_thread   = false,
+        .subtree_credit     = 1.0,  // trace the first sampled subtree
+        .callstack_events   = 0,
+        .locks              = NULL,
+        .noise              = NULL,
+        .team_rank          = 0,
+        .task_generation    = 0,    // implicit tasks are generation 0
+        .implicit_depth     = 0,
+        .waiting_tasks      = stack_create(),
+        .creation           = NULL,
+        .idle_since         = 0,
+        .idle_parallel      = NULL,
+        .dependence_sink    = 0,
+        .sink_predecessors  = NULL
     };
 
     /* Create a location definition for this thread */
@@ -62,6 +205,8 @@ void
 thread_destroy(thread_data_t *thread_data)
 {
     trace_destroy_location(thread_data->location);
+    stack_destroy(thread_data->waiting_tasks, false, NULL);
+    hashmap_destroy(thread_data->sink_predecessors, false, NULL);
     free(thread_data);
 }
 
@@ -71,27 +216,99 @@ new_task_data(
     trace_region_def_t   *parent_task_region,
     unique_id_t           task_id,
     ompt_task_flag_t      flags,
-    int                   has_dependences)
+    int                   has_dependences,
+    unsigned int          depth,
+    task_data_t          *traced_ancestor,
+    const void           *codeptr_ra,
+    uint32_t              callstack_id)
 {
     task_data_t *new = malloc(sizeof(*new));
     *new = (task_data_t) {
         .id     = task_id,
         .type   = flags & OMPT_TASK_TYPE_BITS,
         .flags  = flags,
-        .region = NULL
+        .region = NULL,
+        .untraced_depth = 0,
+        .depth  = depth,
+        .traced_ancestor = traced_ancestor,
+        .resume_time = 0,
+        .exec_time = 0,
+        .parallel = NULL,
+        .construct = NULL,
+        .throttled = false,
+        .has_dependences = has_dependences != 0,
+        .started = false,
+        .create_time = 0,
+        .creating_thread = 0,
+        .outer_team_rank = 0,
+        .barriers = 0,
+        .waiting = false,
+        .last_writer = NULL,
+        .sibling_writers = NULL,
+        .lineage = NULL
     };
+
+    /* A sampled-out task has no region of its own, it is only counted into
+       the region of its nearest traced ancestor */
+    if (traced_ancestor != NULL)
+    {
+        trace_add_untraced_descendants(traced_ancestor->region, 1, 0);
+        return new;
+    }
+
     new->region = trace_new_task_region(
         loc, 
         parent_task_region, 
         new->id,
         flags, 
-        has_dependences
+        has_dependences,
+        codeptr_ra,
+        callstack_id
     );
     return new;
 }
 
 void task_destroy(task_data_t *task_data)
 {
+    task_lineage_release(task_data->lineage);
     free(task_data);
     return;
 }
+
+task_lineage_t *
+new_task_lineage(task_lineage_t *parent, unsigned int depth)
+{
+    task_lineage_t *lineage = malloc(sizeof(*lineage));
+    *lineage = (task_lineage_t) {
+        .parent = parent,
+        .depth  = depth,
+        .refs   = 1,
+        .subtree_time = 0
+    };
+    if (parent != NULL) __sync_fetch_and_add(&parent->refs, 1);
+    return lineage;
+}
+
+/* Release a reference to a lineage, and to its ancestors in turn as each is
+   no longer referenced */
+void
+task_lineage_release(task_lineage_t *lineage)
+{
+    while (lineage != NULL && __sync_sub_and_fetch(&lineage->refs, 1) == 0)
+    {
+        task_lineage_t *parent = lineage->parent;
+        free(lineage);
+        lineage = parent;
+    }
+    return;
+}
+
+bool
+task_is_descendant(const task_data_t *task, const task_data_t *ancestor)
+{
+    if (task->lineage == NULL || ancestor->lineage == NULL) return false;
+    const task_lineage_t *lineage = task->lineage->parent;
+    while (lineage != NULL && lineage->depth > ancestor->lineage->depth)
+        lineage = lineage->parent;
+    return lineage == ancestor->lineage;
+}
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <macros/debug.h>
+#include <otter-datatypes/hashmap.h>
+
+/* An empty slot has key 0, so key 0 is stored in its own slot */
+#define EMPTY_KEY 0
+
+typedef struct slot_t slot_t;
+
+struct slot_t {
+    uint64_t       key;
+    data_item_t    item;
+};
+
+struct hashmap_t {
+    size_t       capacity;  // always a power of 2
+    size_t       size;
+    slot_t      *slots;
+    slot_t       zero;
+};
+
+static uint64_t hash_key(uint64_t key);
+static data_item_t publish_item(slot_t *slot, data_item_t item);
+static slot_t *claim_slot(hashmap_t *m, uint64_t key);
+
+hashmap_t *
+hashmap_create(size_t capacity)
+{
+    hashmap_t *m = malloc(sizeof(*m));
+    if (m == NULL)
+    {
+        LOG_ERROR("failed to create hashmap");
+        return NULL;
+    }
+
+    m->capacity = 1;
+    while (m->capacity < capacity) m->capacity <<= 1;
+
+    m->slots = calloc(m->capacity, sizeof(*m->slots));
+    if (m->slots == NULL)
+    {
+        LOG_ERROR("failed to allocate %lu hashmap slots", m->capacity);
+        free(m);
+        return NULL;
+    }
+
+    m->size = 0;
+    m->zero = (slot_t) {.key = EMPTY_KEY, .item = {.value = 0}};
+    LOG_DEBUG("%p (capacity %lu)", m, m->capacity);
+    return m;
+}
+
+bool
+hashmap_find(hashmap_t *m, uint64_t key, data_item_t *dest)
+{
+    if (m == NULL) return false;
+
+    slot_t *slot = NULL;
+
+    if (key == EMPTY_KEY)
+    {
+        slot = &m->zero;
+    } else {
+        size_t mask = m->capacity - 1;
+        size_t i = hash_key(key) & mask;
+        size_t n = 0;
+        for (n = 0; n < m->capacity; n++, i = (i+1) & mask)
+        {
+            uint64_t k = __atomic_load_n(&m->slots[i].key, __ATOMIC_ACQUIRE);
+            if (k == key) { slot = &m->slots[i]; break; }
+            if (k == EMPTY_KEY) return false;
+        }
+    }
+
+    if (slot == NULL) return false;
+
+    /* the key may be claimed by a thread which hasn't yet stored its item */
+    data_item_t item = {
+        .value = __atomic_load_n(&slot->item.value, __ATOMIC_ACQUIRE)
+    };
+    if (item.value == 0) return false;
+    if (dest != NULL) *dest = item;
+    return true;
+}
+
+data_item_t
+hashmap_insert(hashmap_t *m, uint64_t key, data_item_t item)
+{
+    if (m == NULL || item.value == 0)
+    {
+        LOG_ERROR("can't insert null item into hashmap %p", m);
+        return (data_item_t) {.value = 0};
+    }
+
+    slot_t *slot = claim_slot(m, key);
+    if (slot == NULL) return (data_item_t) {.value = 0};
+    return publish_item(slot, item);
+}
+
+data_item_t
+hashmap_exchange(hashmap_t *m, uint64_t key, data_item_t item)
+{
+    if (m == NULL || item.value == 0)
+    {
+        LOG_ERROR("can't store null item in hashmap %p", m);
+        return (data_item_t) {.value = 0};
+    }
+
+    slot_t *slot = claim_slot(m, key);
+    if (slot == NULL) return (data_item_t) {.value = 0};
+    return (data_item_t) {
+        .value = __atomic_exchange_n(
+            &slot->item.value, item.value, __ATOMIC_ACQ_REL)
+    };
+}
+
+void
+hashmap_clear(hashmap_t *m)
+{
+    if (m == NULL) return;
+    memset(m->slots, 0, m->capacity * sizeof(*m->slots));
+    m->zero = (slot_t) {.key = EMPTY_KEY, .item = {.value = 0}};
+    m->size = 0;
+    return;
+}
+
+size_t
+hashmap_size(hashmap_t *m)
+{
+    return (m == NULL) ? 0 :
+        __atomic_load_n(&m->size, __ATOMIC_RELAXED) + (m->zero.item.value != 0);
+}
+
+bool
+hashmap_scan(
+    hashmap_t   *m,
+    uint64_t    *key,
+    data_item_t *dest,
+    size_t      *next)
+{
+    if ((m == NULL) || (key == NULL) || (dest == NULL) || (next == NULL))
+    {
+        LOG_ERROR("null pointer");
+        return false;
+    }
+
+    /* position 0 is the slot for key 0, position i+1 is slot i */
+    while (*next <= m->capacity)
+    {
+        slot_t *slot = (*next == 0) ? &m->zero : &m->slots[*next - 1];
+        *next += 1;
+        data_item_t item = {
+            .value = __atomic_load_n(&slot->item.value, __ATOMIC_ACQUIRE)
+        };
+        if (item.value != 0)
+        {
+            *key  = slot->key;
+            *dest = item;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+hashmap_destroy(hashmap_t *m, bool items, data_destructor_t destructor)
+{
+    if (m == NULL) return;
+    if (items)
+    {
+        uint64_t key = 0;
+        data_item_t item = {.value = 0};
+        size_t next = 0;
+        while (hashmap_scan(m, &key, &item, &next))
+            destructor != NULL ? destructor(item.ptr) : free(item.ptr);
+    }
+    LOG_DEBUG("%p", m);
+    free(m->slots);
+    free(m);
+    return;
+}
+
+/* Find the slot for key, claiming an empty one if key isn't yet present.
+   Returns NULL if the map is full */
+static slot_t *
+claim_slot(hashmap_t *m, uint64_t key)
+{
+    if (key == EMPTY_KEY) return &m->zero;
+
+    size_t mask = m->capacity - 1;
+    size_t i = hash_key(key) & mask;
+    size_t n = 0;
+    for (n = 0; n < m->capacity; n++, i = (i+1) & mask)
+    {
+        uint64_t k = __atomic_load_n(&m->slots[i].key, __ATOMIC_ACQUIRE);
+        if (k == EMPTY_KEY)
+        {
+            /* try to claim this slot for key */
+            k = __sync_val_compare_and_swap(&m->slots[i].key, EMPTY_KEY, key);
+            if (k == EMPTY_KEY)
+            {
+                __sync_fetch_and_add(&m->size, 1);
+                k = key;
+            }
+        }
+        if (k == key) return &m->slots[i];
+    }
+
+    LOG_ERROR("hashmap %p is full (capacity %lu)", m, m->capacity);
+    return NULL;
+}
+
+/* Store item in an empty slot, or return the item already stored there */
+static data_item_t
+publish_item(slot_t *slot, data_item_t item)
+{
+    uint64_t prior = __sync_val_compare_and_swap(&slot->item.value, 0, item.value);
+    return (prior == 0) ? item : (data_item_t) {.value = prior};
+}
+
+/* splitmix64 finaliser - spreads nearby addresses across the table */
+static uint64_t
+hash_key(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9UL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebUL;
+    key ^= key >> 31;
+    return key;
+}
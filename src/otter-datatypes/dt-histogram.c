@@ -0,0 +1,31 @@
+#include <stdint.h>
+
+#include <otter-datatypes/histogram.h>
+
+unsigned int
+histogram_bin(uint64_t value, unsigned int n_bins)
+{
+    unsigned int bin = value == 0 ? 0 : 63 - __builtin_clzll(value);
+    return bin < n_bins ? bin : n_bins - 1;
+}
+
+void
+histogram_add(uint64_t *histogram, unsigned int n_bins, uint64_t value)
+{
+    histogram[histogram_bin(value, n_bins)]++;
+    return;
+}
+
+uint64_t
+histogram_percentile(const uint64_t *histogram, unsigned int n_bins, double p)
+{
+    uint64_t total = 0, count = 0;
+    unsigned int k=0;
+    for (k=0; k<n_bins; k++) total += histogram[k];
+    for (k=0; k<n_bins; k++)
+    {
+        count += histogram[k];
+        if (count >= p * total) break;
+    }
+    return k < n_bins - 1 ? (2ULL << k) - 1 : UINT64_MAX;
+}
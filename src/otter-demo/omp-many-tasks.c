@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/* Create many short tasks on every thread, e.g. to measure the rate at which
+   Otter can record them */
+
+int main(int argc, char *argv[]) {
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s tasks-per-thread\n", argv[0]);
+        return 1;
+    }
+
+    long n = atol(argv[1]);
+    long sum = 0;
+
+    double start = omp_get_wtime();
+    #pragma omp parallel shared(n) reduction(+:sum)
+    {
+        long k;
+        for (k=0; k<n; k++)
+        {
+            #pragma omp task firstprivate(k) shared(sum)
+            {
+                #pragma omp atomic
+                sum += k & 1;
+            }
+        }
+        #pragma omp taskwait
+    }
+    double elapsed = omp_get_wtime() - start;
+
+    long tasks = n * omp_get_max_threads();
+    printf("%ld tasks on %d threads in %.3f s (%.0f tasks/s, sum=%ld)\n",
+        tasks, omp_get_max_threads(), elapsed, tasks / elapsed, sum);
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <execinfo.h>
+
+#include <macros/debug.h>
+#include <otter-trace/trace-callstacks.h>
+#include <otter-trace/trace-symbols.h>
+#include <otter-datatypes/hashmap.h>
+
+/* Frames captured in addition to CALLSTACK_MAX_FRAMES to allow for those
+   inside Otter and the runtime */
+#define CALLSTACK_SKIP_FRAMES 16
+
+/* Maximum number of distinct call stacks */
+#define CALLSTACK_TABLE_CAPACITY 65536
+
+typedef struct callstack_t {
+    uint32_t     id;
+    int          n_frames;
+    void        *frames[CALLSTACK_MAX_FRAMES];
+} callstack_t;
+
+/* Hash-consed call stacks, keyed by a hash of their frames. A stack whose hash
+   collides with a different stack is stored under the next free key */
+static hashmap_t *callstacks = NULL;
+static uint32_t next_id = CALLSTACK_NONE + 1;
+
+static uint64_t hash_frames(void **frames, int n_frames);
+
+void
+trace_callstacks_initialise(void)
+{
+    callstacks = hashmap_create(CALLSTACK_TABLE_CAPACITY);
+
+    /* backtrace() loads libgcc on first use, so do that now */
+    void *frames[1];
+    backtrace(frames, 1);
+    return;
+}
+
+uint32_t
+trace_callstack_capture(const void *codeptr_ra)
+{
+    void *frames[CALLSTACK_MAX_FRAMES + CALLSTACK_SKIP_FRAMES];
+    int n = backtrace(frames, CALLSTACK_MAX_FRAMES + CALLSTACK_SKIP_FRAMES);
+
+    /* The first application frame is the one returning to codeptr_ra. If it
+       isn't found, keep everything but this function's frame */
+    int first = 1;
+    for (int k=0; k<n; k++)
+    {
+        if (frames[k] == codeptr_ra) { first = k; break; }
+    }
+    if (first >= n) return CALLSTACK_NONE;
+    int n_frames = n - first;
+    if (n_frames > CALLSTACK_MAX_FRAMES) n_frames = CALLSTACK_MAX_FRAMES;
+
+    callstack_t *new = NULL;
+    uint64_t key = hash_frames(&frames[first], n_frames);
+    data_item_t item = {.ptr = NULL};
+
+    /* Find the identical stack, or insert this one at the first free key */
+    for (;;)
+    {
+        if (!hashmap_find(callstacks, key, &item))
+        {
+            if (new == NULL)
+            {
+                new = malloc(sizeof(*new));
+                new->id = CALLSTACK_NONE;
+                new->n_frames = n_frames;
+                memcpy(new->frames, &frames[first], n_frames * sizeof(void*));
+            }
+            item = hashmap_insert(callstacks, key, (data_item_t) {.ptr = new});
+            if (item.ptr == NULL)
+            {
+                free(new);
+                return CALLSTACK_NONE;
+            }
+            if (item.ptr == new)
+            {
+                /* publish the id last: readers wait for it below */
+                __atomic_store_n(&new->id,
+                    __sync_fetch_and_add(&next_id, 1), __ATOMIC_RELEASE);
+                return new->id;
+            }
+        }
+
+        /* item is the stack already stored under key */
+        callstack_t *stack = item.ptr;
+        if (stack->n_frames == n_frames
+            && memcmp(stack->frames, &frames[first],
+                n_frames * sizeof(void*)) == 0)
+        {
+            free(new);
+            uint32_t id = CALLSTACK_NONE;
+            while ((id = __atomic_load_n(&stack->id, __ATOMIC_ACQUIRE))
+                == CALLSTACK_NONE);
+            return id;
+        }
+        key++;
+    }
+}
+
+void
+trace_callstacks_finalise(const char *path)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+    {
+        LOG_ERROR("failed to write call stacks to %s", path);
+    } else {
+        fprintf(out, "# call stack id, number of frames, then one frame per "
+            "line (innermost first): address function\n");
+        uint64_t key = 0;
+        data_item_t item = {.ptr = NULL};
+        size_t next = 0;
+        while (hashmap_scan(callstacks, &key, &item, &next))
+        {
+            callstack_t *stack = item.ptr;
+            fprintf(out, "%u %d\n", stack->id, stack->n_frames);
+            for (int k=0; k<stack->n_frames; k++)
+            {
+                const symbol_info_t *sym =
+                    symbols_lookup(stack->frames[k], false);
+                fprintf(out, "    %p %s\n", stack->frames[k],
+                    sym && sym->function ? sym->function : "??");
+            }
+        }
+        fclose(out);
+    }
+    hashmap_destroy(callstacks, true, NULL);
+    callstacks = NULL;
+    return;
+}
+
+static uint64_t
+hash_frames(void **frames, int n_frames)
+{
+    /* FNV-1a over the frame addresses */
+    uint64_t hash = 0xcbf29ce484222325UL;
+    for (int k=0; k<n_frames; k++)
+    {
+        hash ^= (uint64_t) frames[k];
+        hash *= 0x100000001b3UL;
+    }
+    return hash;
+}
@@ -24,17 +24,41 @@
 
 #include <otter-datatypes/queue.h>
 #include <otter-datatypes/stack.h>
-
-static uint64_t get_timestamp(void);
+#include <otter-datatypes/hashmap.h>
+#include <otter-datatypes/histogram.h>
+#include <otter-trace/trace-symbols.h>
+#include <otter-trace/trace-callstacks.h>
+#include <otter-trace/trace-counters.h>
+#include <otter-trace/trace-topology.h>
 
 /* apply a region's attributes to an event */
 static void trace_add_thread_attributes(trace_location_def_t *self);
-static void trace_add_common_event_attributes(trace_region_def_t *rgn);
+static void trace_add_common_event_attributes(
+    trace_location_def_t *self, trace_region_def_t *rgn);
+static int trace_location_cpu(trace_location_def_t *self);
 static void trace_add_parallel_attributes(trace_region_def_t *rgn);
 static void trace_add_workshare_attributes(trace_region_def_t *rgn);
 static void trace_add_master_attributes(trace_region_def_t *rgn);
 static void trace_add_sync_attributes(trace_region_def_t *rgn);
 static void trace_add_task_attributes(trace_region_def_t *rgn);
+static void trace_flush_pending_enter(trace_location_def_t *self);
+
+/* Source location of a construct, as references to global definitions */
+typedef struct trace_source_t {
+    OTF2_StringRef  function;
+    OTF2_StringRef  file;       // "file:line"
+} trace_source_t;
+
+static const trace_source_t *trace_get_source(const void *codeptr_ra);
+static void trace_write_maps_snapshot(void);
+static OTF2_StringRef trace_get_histogram_string(const uint64_t *histogram,
+    unsigned int n_bins);
+static void trace_write_team_definitions(uint64_t n_locations);
+static void trace_write_source_strings(void);
+static void trace_write_counter_definitions(unsigned int n);
+static void trace_write_system_tree(const char *hostname);
+static OTF2_StringRef trace_get_string_ref(const char *text);
+static void trace_write_counters(trace_location_def_t *self, uint64_t time);
 
 /* Lookup tables mapping enum value to string ref */
 static OTF2_StringRef attr_name_ref[n_attr_defined][2] = {0};
@@ -44,10 +68,78 @@ static OTF2_StringRef attr_label_ref[n_attr_label_defined] = {0};
 OTF2_Archive *Archive = NULL;
 OTF2_GlobalDefWriter *Defs = NULL;
 
+/* Marker writer, shared by all threads and protected by lock_global_archive */
+static OTF2_MarkerWriter *Markers = NULL;
+
 /* Mutexes for thread-safe access to Archive and Defs */
 pthread_mutex_t lock_global_def_writer = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t lock_global_archive    = PTHREAD_MUTEX_INITIALIZER;
 
+/* Marker definitions, indexed by trace_marker_type_t */
+static const struct {
+    const char          *category;
+    OTF2_MarkerSeverity  severity;
+} marker_defs[NUM_MARKER_TYPES] = {
+    [trace_marker_activation] = {"tracing activation", OTF2_SEVERITY_LOW},
+    [trace_marker_throttling] = {"task throttling",    OTF2_SEVERITY_MEDIUM},
+    [trace_marker_preemption] = {"thread preemption",  OTF2_SEVERITY_MEDIUM},
+    [trace_marker_migration]  = {"CPU migration",      OTF2_SEVERITY_LOW},
+    [trace_marker_oversubscription] = {"CPU oversubscription",
+        OTF2_SEVERITY_HIGH}
+};
+
+/* Source locations of constructs, keyed by codeptr_ra. Their string refs are
+   used in region definitions as soon as they are reserved, and the strings
+   are written by trace_write_source_strings */
+#define SOURCE_CACHE_CAPACITY 8192
+static hashmap_t *source_cache = NULL;
+
+/* Strings defined while tracing (e.g. histograms), keyed by a hash of their
+   text. Protected by lock_global_def_writer */
+#define HISTOGRAM_CACHE_CAPACITY 4096
+static hashmap_t *defined_strings = NULL;
+
+/* Thread teams, whose definitions are written once all locations are known as
+   each team's members are ranks in a group of all locations. Protected by
+   lock_global_def_writer */
+typedef struct trace_team_def_t {
+    OTF2_CommRef    team;
+    uint32_t        size;
+    uint64_t        members[];
+} trace_team_def_t;
+static queue_t *team_defs = NULL;
+
+/* Number of performance counters written with each task & parallel region
+   event (see OTTER_COUNTERS) */
+static unsigned int n_counters = 0;
+
+/* Write a marker whenever a thread changes CPU (see OTTER_NOISE) */
+static bool migration_markers = false;
+
+/* For flagging oversubscribed parallel regions */
+static size_t online_cpus = 0;
+
+/* Location of the initial thread, the sole member of the initial team */
+OTF2_LocationRef initial_location_ref = OTF2_UNDEFINED_LOCATION;
+
+/* Where to copy /proc/self/maps to for resolving addresses post-mortem */
+static char maps_path[DEFAULT_NAME_BUF_SZ+1] = {0};
+
+/* Where to write the call stack table, if call stacks are captured */
+static char stacks_path[DEFAULT_NAME_BUF_SZ+1] = {0};
+
+/* Workshare, sync & master regions shorter than this (ns) aren't written.
+   0 disables elision */
+static uint64_t elide_threshold = 0;
+
+/* Whether a region's enter event may be deferred until it is known whether
+   the region is shorter than elide_threshold */
+#define REGION_MAY_BE_ELIDED(rgn)                                              \
+    (elide_threshold > 0                                                       \
+        && ((rgn)->type == trace_region_workshare                              \
+            || (rgn)->type == trace_region_synchronise                         \
+            || (rgn)->type == trace_region_master))
+
 /* Pre- and post-flush callbacks required by OTF2 */
 static OTF2_FlushType
 pre_flush(
@@ -76,6 +168,9 @@ post_flush(
 bool
 trace_initialise_archive(otter_opt_t *opt)
 {
+    elide_threshold = opt->elide_threshold;
+    migration_markers = opt->noise;
+
     /* Determine filename & path from options */
     char archive_path[DEFAULT_NAME_BUF_SZ+1] = {0};
     static char archive_name[DEFAULT_NAME_BUF_SZ+1] = {0};
@@ -107,6 +202,19 @@ trace_initialise_archive(otter_opt_t *opt)
     fprintf(stderr, "%-30s %s/%s\n",
         "Trace output path:", opt->tracepath, archive_name);
 
+    snprintf(maps_path, DEFAULT_NAME_BUF_SZ, "%s/%s.maps",
+        archive_path, archive_name);
+    source_cache = hashmap_create(SOURCE_CACHE_CAPACITY);
+    defined_strings = hashmap_create(HISTOGRAM_CACHE_CAPACITY);
+    team_defs = queue_create();
+
+    if (opt->callstacks > 0)
+    {
+        snprintf(stacks_path, DEFAULT_NAME_BUF_SZ, "%s/%s.stacks",
+            archive_path, archive_name);
+        trace_callstacks_initialise();
+    }
+
     /* Store archive name in options struct */
     opt->archive_name = &archive_name[0];
 
@@ -142,6 +250,15 @@ trace_initialise_archive(otter_opt_t *opt)
     /* get global definitions writer */
     Defs = OTF2_Archive_GetGlobalDefWriter(Archive);
 
+    /* get marker writer & define the kinds of marker Otter may write */
+    Markers = OTF2_Archive_GetMarkerWriter(Archive);
+    int m=0;
+    for (m=0; m<NUM_MARKER_TYPES; m++)
+    {
+        OTF2_MarkerWriter_WriteDefMarker(Markers, m, "Otter",
+            marker_defs[m].category, marker_defs[m].severity);
+    }
+
     /* get clock resolution & current time for CLOCK_MONOTONIC */
     struct timespec res, tp;
     if (clock_getres(CLOCK_MONOTONIC, &res) != 0)
@@ -170,15 +287,9 @@ trace_initialise_archive(otter_opt_t *opt)
 
     /* write global system tree */
     OTF2_SystemTreeNodeRef g_sys_tree_id = DEFAULT_SYSTEM_TREE;
-    OTF2_StringRef g_sys_tree_name = get_unique_str_ref();
-    OTF2_StringRef g_sys_tree_class = get_unique_str_ref();
-    OTF2_GlobalDefWriter_WriteString(Defs, g_sys_tree_name, "Sytem Tree");
-    OTF2_GlobalDefWriter_WriteString(Defs, g_sys_tree_class, "node");
-    OTF2_GlobalDefWriter_WriteSystemTreeNode(Defs,
-        g_sys_tree_id,
-        g_sys_tree_name,
-        g_sys_tree_class,
-        OTF2_UNDEFINED_SYSTEM_TREE_NODE);
+    trace_topology_initialise();
+    trace_topology_cpus(&online_cpus);
+    trace_write_system_tree(opt->hostname);
 
     /* write global location group */
     OTF2_StringRef g_loc_grp_name = get_unique_str_ref();
@@ -187,6 +298,33 @@ trace_initialise_archive(otter_opt_t *opt)
     OTF2_GlobalDefWriter_WriteLocationGroup(Defs, g_loc_grp_id, g_loc_grp_name,
         OTF2_LOCATION_GROUP_TYPE_PROCESS, g_sys_tree_id);
 
+    /* reserve the initial team's comm ref, defined at finalisation */
+    OTF2_CommRef initial_team = get_unique_comm_ref();
+    LOG_ERROR_IF((initial_team != INITIAL_TEAM_COMM),
+        "unexpected initial team ref %u", initial_team);
+
+    /* define the parameter written for each task dependence */
+    OTF2_StringRef dependence_name = get_unique_str_ref();
+    OTF2_GlobalDefWriter_WriteString(Defs, dependence_name, "task dependence");
+    OTF2_GlobalDefWriter_WriteParameter(Defs, TASK_DEPENDENCE_PARAMETER,
+        dependence_name, OTF2_PARAMETER_TYPE_UINT64);
+
+    /* ... for each loop chunk */
+    OTF2_StringRef chunk_name = get_unique_str_ref();
+    OTF2_GlobalDefWriter_WriteString(Defs, chunk_name, "workshare chunk");
+    OTF2_GlobalDefWriter_WriteParameter(Defs, LOOP_CHUNK_PARAMETER,
+        chunk_name, OTF2_PARAMETER_TYPE_UINT64);
+
+    /* ... and for each mutex release */
+    OTF2_StringRef mutex_name = get_unique_str_ref();
+    OTF2_GlobalDefWriter_WriteString(Defs, mutex_name, "mutex release");
+    OTF2_GlobalDefWriter_WriteParameter(Defs, MUTEX_RELEASE_PARAMETER,
+        mutex_name, OTF2_PARAMETER_TYPE_UINT64);
+
+    /* define the metric class of any performance counters */
+    n_counters = trace_counters_initialise(opt->counters);
+    if (n_counters > 0) trace_write_counter_definitions(n_counters);
+
     /* define any necessary attributes (their names, descriptions & labels)
        these are defined in trace-attribute-defs.h and included via macros to
        reduce code repetition. */
@@ -237,6 +375,8 @@ trace_finalise_archive(void)
        currently used
      */
     uint64_t nloc = get_unique_loc_ref();
+    trace_write_source_strings();
+    trace_write_team_definitions(nloc);
     int loc = 0;
     for (loc = 0; loc < nloc; loc++)
     {
@@ -247,9 +387,21 @@ trace_finalise_archive(void)
     /* close local definition files */
     OTF2_Archive_CloseDefFiles(Archive);
 
+    /* close marker file */
+    OTF2_Archive_CloseMarkerWriter(Archive, Markers);
+
     /* close OTF2 archive */
     OTF2_Archive_Close(Archive);
 
+    /* keep the memory map with the trace for resolving addresses later */
+    trace_write_maps_snapshot();
+    if (stacks_path[0] != '\0') trace_callstacks_finalise(stacks_path);
+    hashmap_destroy(source_cache, true, NULL);
+    source_cache = NULL;
+    hashmap_destroy(defined_strings, false, NULL);
+    defined_strings = NULL;
+    trace_topology_finalise();
+
     return true;
 }
 
@@ -270,6 +422,11 @@ trace_write_location_definition(trace_location_def_t *loc)
     OTF2_StringRef location_name_ref = get_unique_str_ref();
     snprintf(location_name, DEFAULT_NAME_BUF_SZ, "Thread %lu", loc->id);
 
+    /* Property names are shared by every location. Looked up before locking
+       the def writer, which trace_get_string_ref locks itself */
+    OTF2_StringRef affinity_ref = trace_get_string_ref("affinity");
+    OTF2_StringRef place_ref = trace_get_string_ref("place");
+
     LOG_DEBUG("[t=%lu] locking global def writer", loc->id);
     pthread_mutex_lock(&lock_global_def_writer);
 
@@ -285,6 +442,12 @@ trace_write_location_definition(trace_location_def_t *loc)
         loc->events,
         loc->location_group);
 
+    /* Where the thread could run when it began */
+    OTF2_GlobalDefWriter_WriteLocationProperty(Defs, loc->ref, affinity_ref,
+        OTF2_TYPE_STRING, (OTF2_AttributeValue) {.stringRef = loc->affinity});
+    OTF2_GlobalDefWriter_WriteLocationProperty(Defs, loc->ref, place_ref,
+        OTF2_TYPE_INT32, (OTF2_AttributeValue) {.int32 = loc->place});
+
     LOG_DEBUG("[t=%lu] unlocking global def writer", loc->id);
     pthread_mutex_unlock(&lock_global_def_writer);
 
@@ -303,6 +466,10 @@ trace_write_region_definition(trace_region_def_t *rgn)
     LOG_DEBUG("writing region definition %3u (type=%3d, role=%3u) %p",
         rgn->ref, rgn->type, rgn->role, rgn);
 
+    /* Source location of the construct, whose strings are only written once
+       tracing is finished so that it isn't resolved inside OpenMP callbacks */
+    const trace_source_t *src = trace_get_source(rgn->codeptr_ra);
+
     switch (rgn->type)
     {
         case trace_region_parallel:
@@ -317,11 +484,21 @@ trace_write_region_definition(trace_region_def_t *rgn)
             OTF2_GlobalDefWriter_WriteRegion(Defs,
                 rgn->ref,
                 region_name_ref,
-                0, 0,   /* canonical name, description */
+                src->function, 0,   /* canonical name, description */
                 rgn->role,
                 OTF2_PARADIGM_OPENMP,
                 OTF2_REGION_FLAG_NONE,
-                0, 0, 0); /* source file, begin line no., end line no. */
+                src->file, 0, 0);
+
+            /* Keep the team's members for trace_write_team_definitions */
+            trace_parallel_region_attr_t *parallel = &rgn->attr.parallel;
+            trace_team_def_t *team = malloc(
+                sizeof(*team) + parallel->team_size * sizeof(uint64_t));
+            team->team = parallel->team;
+            team->size = parallel->team_size;
+            memcpy(team->members, parallel->members,
+                parallel->team_size * sizeof(uint64_t));
+            queue_push(team_defs, (data_item_t) {.ptr = team});
             break;
         }
         case trace_region_workshare:
@@ -329,11 +506,11 @@ trace_write_region_definition(trace_region_def_t *rgn)
             OTF2_GlobalDefWriter_WriteRegion(Defs,
                 rgn->ref,
                 WORK_TYPE_TO_STR_REF(rgn->attr.wshare.type),
-                0, 0,
+                src->function, 0,
                 rgn->role,
                 OTF2_PARADIGM_OPENMP,
                 OTF2_REGION_FLAG_NONE,
-                0, 0, 0); /* source file, begin line no., end line no. */
+                src->file, 0, 0);
             break;
         }
         case trace_region_master:
@@ -341,11 +518,11 @@ trace_write_region_definition(trace_region_def_t *rgn)
             OTF2_GlobalDefWriter_WriteRegion(Defs,
                 rgn->ref,
                 attr_label_ref[attr_region_type_master],
-                0, 0,
+                src->function, 0,
                 rgn->role,
                 OTF2_PARADIGM_OPENMP,
                 OTF2_REGION_FLAG_NONE,
-                0, 0, 0); /* source file, begin line no., end line no. */
+                src->file, 0, 0);
             break;
         }
         case trace_region_synchronise:
@@ -353,11 +530,11 @@ trace_write_region_definition(trace_region_def_t *rgn)
             OTF2_GlobalDefWriter_WriteRegion(Defs,
                 rgn->ref,
                 SYNC_TYPE_TO_STR_REF(rgn->attr.sync.type),
-                0, 0,
+                src->function, 0,
                 rgn->role,
                 OTF2_PARADIGM_OPENMP,
                 OTF2_REGION_FLAG_NONE,
-                0, 0, 0); /* source file, begin line no., end line no. */
+                src->file, 0, 0);
             break;
         }
         case trace_region_task:
@@ -374,11 +551,11 @@ trace_write_region_definition(trace_region_def_t *rgn)
             OTF2_GlobalDefWriter_WriteRegion(Defs,
                 rgn->ref,
                 task_name_ref,
-                0, 0,   /* canonical name, description */
+                src->function, 0,   /* canonical name, description */
                 rgn->role,
                 OTF2_PARADIGM_OPENMP,
                 OTF2_REGION_FLAG_NONE,
-                0, 0, 0); /* source file, begin line no., end line no. */
+                src->file, 0, 0);
             break;
         }
         default:
@@ -394,12 +571,15 @@ trace_write_region_definition(trace_region_def_t *rgn)
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 static void
-trace_add_common_event_attributes(trace_region_def_t *rgn)
+trace_add_common_event_attributes(
+    trace_location_def_t *self,
+    trace_region_def_t   *rgn)
 {
     OTF2_ErrorCode r = OTF2_SUCCESS;
 
     /* CPU of encountering thread */
-    r = OTF2_AttributeList_AddInt32(rgn->attributes, attr_cpu, sched_getcpu());
+    r = OTF2_AttributeList_AddInt32(rgn->attributes, attr_cpu,
+        trace_location_cpu(self));
     CHECK_OTF2_ERROR_CODE(r);
 
     /* Add encountering task ID */
@@ -426,6 +606,23 @@ trace_add_common_event_attributes(trace_region_def_t *rgn)
     );
     CHECK_OTF2_ERROR_CODE(r);
 
+    /* Call stack at region creation */
+    if (rgn->callstack_id != CALLSTACK_NONE)
+    {
+        r = OTF2_AttributeList_AddUint32(rgn->attributes, attr_callstack_id,
+            rgn->callstack_id);
+        CHECK_OTF2_ERROR_CODE(r);
+    }
+
+    /* Short regions nested in this one which were elided */
+    uint64_t elided = __atomic_load_n(&rgn->elided_regions, __ATOMIC_RELAXED);
+    if (elided > 0)
+    {
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_elided_regions,
+            elided);
+        CHECK_OTF2_ERROR_CODE(r);
+    }
+
     return;
 }
 
@@ -433,7 +630,8 @@ static void
 trace_add_thread_attributes(trace_location_def_t *self)
 {
     OTF2_ErrorCode r = OTF2_SUCCESS;
-    r = OTF2_AttributeList_AddInt32(self->attributes, attr_cpu, sched_getcpu());
+    r = OTF2_AttributeList_AddInt32(self->attributes, attr_cpu,
+        trace_location_cpu(self));
     CHECK_OTF2_ERROR_CODE(r);
     r = OTF2_AttributeList_AddUint64(self->attributes, attr_unique_id, self->id);
     CHECK_OTF2_ERROR_CODE(r);
@@ -456,10 +654,108 @@ trace_add_parallel_attributes(trace_region_def_t *rgn)
     r = OTF2_AttributeList_AddUint32(rgn->attributes, attr_requested_parallelism,
         rgn->attr.parallel.requested_parallelism);
     CHECK_OTF2_ERROR_CODE(r);
+
+    /* Only known once the team has begun */
+    trace_parallel_region_attr_t *parallel = &rgn->attr.parallel;
+    unsigned int team_size =
+        __atomic_load_n(&parallel->team_size, __ATOMIC_RELAXED);
+    if (team_size > 0)
+    {
+        unsigned int peak =
+            __atomic_load_n(&parallel->peak_threads, __ATOMIC_RELAXED);
+        r = OTF2_AttributeList_AddUint32(rgn->attributes,
+            attr_actual_parallelism, team_size);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint8(rgn->attributes, attr_team_shortfall,
+            team_size < parallel->requested_parallelism);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint32(rgn->attributes, attr_peak_threads,
+            peak);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint8(rgn->attributes, attr_oversubscribed,
+            online_cpus > 0 && peak > online_cpus);
+        CHECK_OTF2_ERROR_CODE(r);
+    }
+    /* Explicit tasks by how they were executed, once any were created */
+    uint64_t *tasks = parallel->category_tasks, *time = parallel->category_time;
+    if (tasks[trace_task_deferred] + tasks[trace_task_undeferred]
+        + tasks[trace_task_final] + tasks[trace_task_merged] > 0)
+    {
+        #define ADD_CATEGORY(attr, array, category)                            \
+            r = OTF2_AttributeList_AddUint64(rgn->attributes, attr,            \
+                __atomic_load_n(&array[category], __ATOMIC_RELAXED));          \
+            CHECK_OTF2_ERROR_CODE(r);
+        ADD_CATEGORY(attr_tasks_deferred,   tasks, trace_task_deferred);
+        ADD_CATEGORY(attr_tasks_undeferred, tasks, trace_task_undeferred);
+        ADD_CATEGORY(attr_tasks_final,      tasks, trace_task_final);
+        ADD_CATEGORY(attr_tasks_merged,     tasks, trace_task_merged);
+        ADD_CATEGORY(attr_deferred_task_time,   time, trace_task_deferred);
+        ADD_CATEGORY(attr_undeferred_task_time, time, trace_task_undeferred);
+        ADD_CATEGORY(attr_final_task_time,      time, trace_task_final);
+        ADD_CATEGORY(attr_merged_task_time,     time, trace_task_merged);
+        #undef ADD_CATEGORY
+    }
+
+    /* Only known once the region ends */
+    trace_task_production_t *production = &parallel->production;
+    if (production->tasks > 0)
+    {
+        r = OTF2_AttributeList_AddUint32(rgn->attributes, attr_task_producers,
+            production->producers);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_top_producer_tasks, production->top_producer_tasks);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_producer_time,
+            production->producer_time);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_task_creation_rate, production->creation_rate);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_task_consumption_rate, production->consumption_rate);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_task_starved_time,
+            production->starved_time);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint8(rgn->attributes,
+            attr_producer_bottleneck, production->bottleneck);
+        CHECK_OTF2_ERROR_CODE(r);
+    }
+
+    uint64_t barriers = __atomic_load_n(&parallel->barriers, __ATOMIC_RELAXED);
+    if (barriers > 0)
+    {
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_barriers,
+            barriers);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_barrier_skew,
+            __atomic_load_n(&parallel->barrier_skew, __ATOMIC_RELAXED));
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_max_barrier_skew,
+            __atomic_load_n(&parallel->max_barrier_skew, __ATOMIC_RELAXED));
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_barrier_wait,
+            __atomic_load_n(&parallel->barrier_wait, __ATOMIC_RELAXED));
+        CHECK_OTF2_ERROR_CODE(r);
+    }
     r = OTF2_AttributeList_AddStringRef(rgn->attributes, attr_is_league,
         rgn->attr.parallel.is_league ? 
             attr_label_ref[attr_flag_true] : attr_label_ref[attr_flag_false]);
     CHECK_OTF2_ERROR_CODE(r);
+    r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_skipped_instances,
+        rgn->attr.parallel.skipped_instances);
+    CHECK_OTF2_ERROR_CODE(r);
+    r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_skipped_time,
+        rgn->attr.parallel.skipped_time);
+    CHECK_OTF2_ERROR_CODE(r);
+    r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_throttled_tasks,
+        __atomic_load_n(&rgn->attr.parallel.throttled_tasks, __ATOMIC_RELAXED));
+    CHECK_OTF2_ERROR_CODE(r);
+    r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_throttled_task_time,
+        __atomic_load_n(&rgn->attr.parallel.throttled_task_time,
+            __ATOMIC_RELAXED));
+    CHECK_OTF2_ERROR_CODE(r);
     return;
 }
 
@@ -473,6 +769,23 @@ trace_add_workshare_attributes(trace_region_def_t *rgn)
     r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_workshare_count,
         rgn->attr.wshare.count);
     CHECK_OTF2_ERROR_CODE(r);
+
+    /* Only known once the region is left */
+    trace_wshare_region_attr_t *wshare = &rgn->attr.wshare;
+    if (wshare->chunks > 0)
+    {
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_workshare_chunks, wshare->chunks);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_workshare_iterations, wshare->iterations);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddStringRef(rgn->attributes,
+            attr_workshare_chunk_histogram,
+            trace_get_histogram_string(wshare->chunk_histogram,
+                LOOP_CHUNK_BINS));
+        CHECK_OTF2_ERROR_CODE(r);
+    }
     return;
 }
 
@@ -493,6 +806,34 @@ trace_add_sync_attributes(trace_region_def_t *rgn)
     r = OTF2_AttributeList_AddStringRef(rgn->attributes, attr_sync_type,
         SYNC_TYPE_TO_STR_REF(rgn->attr.sync.type));
     CHECK_OTF2_ERROR_CODE(r);
+
+    /* Only known once the region is left */
+    trace_sync_region_attr_t *sync = &rgn->attr.sync;
+    if (sync->wait_intervals > 0)
+    {
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_sync_wait_intervals, sync->wait_intervals);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_sync_task_time,
+            sync->task_time);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_sync_idle_time,
+            sync->wait_time > sync->task_time ?
+                sync->wait_time - sync->task_time : 0);
+        CHECK_OTF2_ERROR_CODE(r);
+    }
+
+    /* Tasks executed while waiting for a task's descendants to complete */
+    if (sync->type == ompt_sync_region_taskwait
+        || sync->type == ompt_sync_region_taskgroup)
+    {
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_sync_descendant_time, sync->descendant_time);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_sync_unrelated_time, sync->task_time - sync->descendant_time);
+        CHECK_OTF2_ERROR_CODE(r);
+    }
     return;
 }
 
@@ -536,6 +877,32 @@ trace_add_task_attributes(trace_region_def_t *rgn)
     r = OTF2_AttributeList_AddStringRef(rgn->attributes, attr_prior_task_status,
         TASK_STATUS_TO_STR_REF(rgn->attr.task.task_status));
     CHECK_OTF2_ERROR_CODE(r);
+    r = OTF2_AttributeList_AddUint64(rgn->attributes, attr_untraced_descendants,
+        __atomic_load_n(&rgn->attr.task.untraced_descendants, __ATOMIC_RELAXED));
+    CHECK_OTF2_ERROR_CODE(r);
+    r = OTF2_AttributeList_AddUint64(rgn->attributes,
+        attr_untraced_descendant_time,
+        __atomic_load_n(&rgn->attr.task.untraced_descendant_time,
+            __ATOMIC_RELAXED));
+    CHECK_OTF2_ERROR_CODE(r);
+
+    /* Only known once the task has started */
+    trace_task_region_attr_t *task = &rgn->attr.task;
+    if (task->started)
+    {
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_task_start_latency, task->start_latency);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint64(rgn->attributes,
+            attr_task_queued_time, task->queued_time);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint8(rgn->attributes, attr_task_is_stolen,
+            task->stolen);
+        CHECK_OTF2_ERROR_CODE(r);
+        r = OTF2_AttributeList_AddUint8(rgn->attributes, attr_task_is_remote,
+            task->remote);
+        CHECK_OTF2_ERROR_CODE(r);
+    }
     return;
 }
 
@@ -546,7 +913,17 @@ trace_add_task_attributes(trace_region_def_t *rgn)
 void
 trace_event_thread_begin(trace_location_def_t *self)
 {
+    char affinity[DEFAULT_NAME_BUF_SZ + 1] = {0};
+    trace_topology_affinity(affinity, sizeof(affinity));
+    self->affinity = trace_get_string_ref(affinity);
+
     trace_add_thread_attributes(self);
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_thread_affinity,
+        self->affinity);
+    OTF2_AttributeList_AddInt32(self->attributes, attr_thread_place,
+        self->place);
+    OTF2_AttributeList_AddInt32(self->attributes, attr_numa_node,
+        trace_topology_numa_node(self->cpu));
     OTF2_AttributeList_AddStringRef(
         self->attributes,
         attr_event_type,
@@ -571,7 +948,27 @@ trace_event_thread_begin(trace_location_def_t *self)
 void
 trace_event_thread_end(trace_location_def_t *self)
 {
+    trace_flush_pending_enter(self);
     trace_add_thread_attributes(self);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_thread_cpu_migrations,
+        self->migrations);
+    if (self->tasks_started > 0)
+    {
+        OTF2_AttributeList_AddUint64(self->attributes,
+            attr_thread_tasks_started, self->tasks_started);
+        OTF2_AttributeList_AddUint64(self->attributes,
+            attr_thread_tasks_stolen, self->tasks_stolen);
+        OTF2_AttributeList_AddUint64(self->attributes,
+            attr_thread_tasks_remote, self->tasks_remote);
+        OTF2_AttributeList_AddUint64(self->attributes,
+            attr_thread_task_start_latency, self->task_start_latency);
+        OTF2_AttributeList_AddUint64(self->attributes,
+            attr_thread_task_queued_time, self->task_queued_time);
+        OTF2_AttributeList_AddStringRef(self->attributes,
+            attr_thread_task_latency_histogram,
+            trace_get_histogram_string(self->task_latency_histogram,
+                TASK_LATENCY_BINS));
+    }
     OTF2_AttributeList_AddStringRef(
         self->attributes,
         attr_event_type,
@@ -606,6 +1003,9 @@ trace_event_enter(
     stack_print(self->rgn_stack);
     #endif
 
+    /* The enclosing region isn't short enough to elide */
+    trace_flush_pending_enter(self);
+
     if (region->type == trace_region_parallel)
     {
         /* Set up new region definitions queue for the new parallel region */
@@ -624,7 +1024,7 @@ trace_event_enter(
     }
 
     /* Add attributes common to all enter/leave events */
-    trace_add_common_event_attributes(region);
+    trace_add_common_event_attributes(self, region);
 
     /* Add the event type attribute */
     OTF2_AttributeList_AddStringRef(region->attributes, attr_event_type,
@@ -655,9 +1055,28 @@ trace_event_enter(
         abort();
     }
     
-    /* Record the event */
-    OTF2_EvtWriter_Enter(self->evt_writer, 
-        region->attributes, get_timestamp(), region->ref);
+    /* Record the event, or defer it until the region is left */
+    if (REGION_MAY_BE_ELIDED(region))
+    {
+        self->pending_enter = region;
+        self->pending_enter_time = get_timestamp();
+    } else {
+        uint64_t time = get_timestamp();
+        OTF2_EvtWriter_Enter(self->evt_writer, 
+            region->attributes, time, region->ref);
+        if (region->type == trace_region_parallel
+            || region->type == trace_region_task)
+            trace_write_counters(self, time);
+    }
+
+    /* A task executed at a scheduling point in a sync region */
+    trace_region_def_t *enclosing = NULL;
+    if (region->type == trace_region_task
+        && stack_peek(self->rgn_stack, (data_item_t*) &enclosing)
+        && enclosing->type == trace_region_synchronise)
+    {
+        enclosing->attr.sync.task_begin = get_timestamp();
+    }
 
     /* Push region onto location's region stack */
     stack_push(self->rgn_stack, (data_item_t) {.ptr = region});
@@ -698,6 +1117,24 @@ trace_event_leave(trace_location_def_t *self)
 
     LOG_DEBUG("[t=%lu] leave region %p", self->id, region);
 
+    /* Drop both events of a short region whose enter event is still pending
+       and count it in the enclosing region instead */
+    if (self->pending_enter == region)
+    {
+        if (get_timestamp() - self->pending_enter_time < elide_threshold)
+        {
+            self->pending_enter = NULL;
+            OTF2_AttributeList_RemoveAllAttributes(region->attributes);
+            trace_region_def_t *enclosing = NULL;
+            if (stack_peek(self->rgn_stack, (data_item_t*) &enclosing))
+                __sync_fetch_and_add(&enclosing->elided_regions, 1);
+            LOG_DEBUG("[t=%lu] elided region %p", self->id, region);
+            self->events--; /* uncount the enter event */
+            return;
+        }
+    }
+    trace_flush_pending_enter(self);
+
     if (region->type == trace_region_parallel)
     {
         /* Parallel regions must be accessed atomically as they are shared 
@@ -710,7 +1147,7 @@ trace_event_leave(trace_location_def_t *self)
     }
 
     /* Add attributes common to all enter/leave events */
-    trace_add_common_event_attributes(region);
+    trace_add_common_event_attributes(self, region);
 
     /* Add the event type attribute */
     OTF2_AttributeList_AddStringRef(region->attributes, attr_event_type,
@@ -742,8 +1179,27 @@ trace_event_leave(trace_location_def_t *self)
     }
 
     /* Record the event */
-    OTF2_EvtWriter_Leave(self->evt_writer, region->attributes, get_timestamp(),
+    uint64_t time = get_timestamp();
+    OTF2_EvtWriter_Leave(self->evt_writer, region->attributes, time,
         region->ref);
+    if (region->type == trace_region_parallel
+        || region->type == trace_region_task)
+        trace_write_counters(self, time);
+
+    /* Returning to the sync region in which this task was executed */
+    trace_region_def_t *enclosing = NULL;
+    if (region->type == trace_region_task
+        && stack_peek(self->rgn_stack, (data_item_t*) &enclosing)
+        && enclosing->type == trace_region_synchronise
+        && enclosing->attr.sync.task_begin != 0)
+    {
+        uint64_t time = get_timestamp() - enclosing->attr.sync.task_begin;
+        enclosing->attr.sync.task_time += time;
+        if (enclosing->attr.sync.task_descendant)
+            enclosing->attr.sync.descendant_time += time;
+        enclosing->attr.sync.task_begin = 0;
+        enclosing->attr.sync.task_descendant = false;
+    }
     
     /* Parallel regions must be cleaned up by the last thread to leave */
     if (region->type == trace_region_parallel)
@@ -793,7 +1249,10 @@ trace_event_task_create(
     trace_location_def_t *self, 
     trace_region_def_t   *created_task)
 {
-    trace_add_common_event_attributes(created_task);
+    trace_flush_pending_enter(self);
+
+    trace_add_common_event_attributes(self, created_task);
+    created_task->attr.task.creating_numa = trace_topology_numa_node(self->cpu);
 
     /* task-create */
     OTF2_AttributeList_AddStringRef(created_task->attributes, attr_event_type,
@@ -812,8 +1271,60 @@ trace_event_task_create(
         self->evt_writer,
         created_task->attributes,
         get_timestamp(),
-        OTF2_UNDEFINED_COMM,
-        OTF2_UNDEFINED_UINT32, 0); /* creating thread, generation number */
+        created_task->attr.task.team,
+        created_task->attr.task.creating_thread,
+        created_task->attr.task.generation);
+    self->events++;
+    return;
+}
+
+/* The thread starts or resumes executing next_task */
+void
+trace_event_task_switch(
+    trace_location_def_t *self,
+    trace_region_def_t   *next_task)
+{
+    trace_flush_pending_enter(self);
+
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_event_type,
+        attr_label_ref[attr_event_type_task_switch]);
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_endpoint,
+        attr_label_ref[attr_endpoint_discrete]);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_unique_id,
+        next_task->attr.task.id);
+
+    OTF2_EvtWriter_ThreadTaskSwitch(
+        self->evt_writer,
+        self->attributes,
+        get_timestamp(),
+        next_task->attr.task.team,
+        next_task->attr.task.creating_thread,
+        next_task->attr.task.generation);
+    self->events++;
+    return;
+}
+
+void
+trace_event_task_complete(
+    trace_location_def_t *self,
+    trace_region_def_t   *completed_task)
+{
+    trace_flush_pending_enter(self);
+
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_event_type,
+        attr_label_ref[attr_event_type_task_complete]);
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_endpoint,
+        attr_label_ref[attr_endpoint_discrete]);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_unique_id,
+        completed_task->attr.task.id);
+
+    OTF2_EvtWriter_ThreadTaskComplete(
+        self->evt_writer,
+        self->attributes,
+        get_timestamp(),
+        completed_task->attr.task.team,
+        completed_task->attr.task.creating_thread,
+        completed_task->attr.task.generation);
     self->events++;
     return;
 }
@@ -831,11 +1342,523 @@ trace_event_task_schedule(
     return;
 }
 
+void
+trace_workshare_dispatch(
+    trace_location_def_t   *self,
+    uint64_t                start,
+    uint64_t                iterations,
+    bool                    write_event)
+{
+    trace_region_def_t *region = NULL;
+    if (!stack_peek(self->rgn_stack, (data_item_t*) &region)
+        || region->type != trace_region_workshare) return;
+
+    trace_wshare_region_attr_t *wshare = &region->attr.wshare;
+    histogram_add(wshare->chunk_histogram, LOOP_CHUNK_BINS, iterations);
+    wshare->chunks++;
+    wshare->iterations += iterations;
+
+    if (!write_event) return;
+
+    trace_flush_pending_enter(self);
+
+    OTF2_AttributeList_AddInt32(self->attributes, attr_cpu,
+        trace_location_cpu(self));
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_event_type,
+        attr_label_ref[attr_event_type_workshare_chunk]);
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_endpoint,
+        attr_label_ref[attr_endpoint_discrete]);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_encountering_task_id,
+        region->encountering_task_id);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_chunk_start, start);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_chunk_iterations,
+        iterations);
+
+    OTF2_EvtWriter_ParameterUnsignedInt(
+        self->evt_writer,
+        self->attributes,
+        get_timestamp(),
+        LOOP_CHUNK_PARAMETER,
+        start);
+    self->events++;
+    return;
+}
+
+/* Time spent waiting in a sync region, which includes any time spent executing
+   tasks at its scheduling points. Only applies if the region is traced, i.e.
+   is at the top of the location's region stack */
+void
+trace_sync_region_wait(
+    trace_location_def_t   *self,
+    ompt_scope_endpoint_t   endpoint)
+{
+    trace_region_def_t *region = NULL;
+    if (!stack_peek(self->rgn_stack, (data_item_t*) &region)
+        || region->type != trace_region_synchronise) return;
+
+    trace_sync_region_attr_t *sync = &region->attr.sync;
+    if (endpoint == ompt_scope_begin)
+    {
+        sync->wait_begin = get_timestamp();
+        sync->wait_intervals++;
+    } else if (sync->wait_begin != 0) {
+        sync->wait_time += get_timestamp() - sync->wait_begin;
+        sync->wait_begin = 0;
+    }
+    return;
+}
+
+/* Time spent in a sync region executing an untraced task, which has no region
+   of its own */
+void
+trace_sync_region_add_task_time(
+    trace_location_def_t   *self,
+    uint64_t                time,
+    bool                    descendant)
+{
+    trace_region_def_t *region = NULL;
+    if (!stack_peek(self->rgn_stack, (data_item_t*) &region)
+        || region->type != trace_region_synchronise) return;
+    region->attr.sync.task_time += time;
+    if (descendant) region->attr.sync.descendant_time += time;
+    return;
+}
+
+/* Whether the task about to be entered in a sync region is a descendant of
+   the task waiting in the region */
+void
+trace_sync_region_set_descendant(trace_location_def_t *self, bool descendant)
+{
+    trace_region_def_t *region = NULL;
+    if (!stack_peek(self->rgn_stack, (data_item_t*) &region)
+        || region->type != trace_region_synchronise) return;
+    region->attr.sync.task_descendant = descendant;
+    return;
+}
+
+/* Record the release of a mutex, with the time spent waiting for & holding it */
+void
+trace_event_mutex_release(
+    trace_location_def_t   *self,
+    ompt_mutex_t            kind,
+    ompt_wait_id_t          wait_id,
+    const void             *codeptr_ra,
+    uint64_t                wait_time,
+    uint64_t                hold_time)
+{
+    trace_flush_pending_enter(self);
+
+    OTF2_AttributeList_AddInt32(self->attributes, attr_cpu,
+        trace_location_cpu(self));
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_event_type,
+        attr_label_ref[attr_event_type_mutex_release]);
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_endpoint,
+        attr_label_ref[attr_endpoint_discrete]);
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_mutex_kind,
+        MUTEX_KIND_TO_STR_REF(kind));
+    OTF2_AttributeList_AddUint64(self->attributes, attr_wait_id, wait_id);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_codeptr_ra,
+        (uint64_t) codeptr_ra);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_mutex_wait_time,
+        wait_time);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_mutex_hold_time,
+        hold_time);
+
+    OTF2_EvtWriter_ParameterUnsignedInt(
+        self->evt_writer,
+        self->attributes,
+        get_timestamp(),
+        MUTEX_RELEASE_PARAMETER,
+        wait_id);
+    self->events++;
+    return;
+}
+
+/* Record that task_id depends on predecessor_id. The event is written to the
+   location of the thread which created task_id */
+void
+trace_event_task_dependence(
+    trace_location_def_t   *self,
+    unique_id_t             task_id,
+    unique_id_t             predecessor_id,
+    uint64_t                address,
+    ompt_dependence_type_t  type)
+{
+    trace_flush_pending_enter(self);
+
+    OTF2_AttributeList_AddInt32(self->attributes, attr_cpu,
+        trace_location_cpu(self));
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_event_type,
+        attr_label_ref[attr_event_type_task_dependence]);
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_endpoint,
+        attr_label_ref[attr_endpoint_discrete]);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_unique_id, task_id);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_predecessor_task_id,
+        predecessor_id);
+    OTF2_AttributeList_AddUint64(self->attributes, attr_dependence_address,
+        address);
+    OTF2_AttributeList_AddStringRef(self->attributes, attr_dependence_type,
+        DEPENDENCE_TYPE_TO_STR_REF(type));
+
+    OTF2_EvtWriter_ParameterUnsignedInt(
+        self->evt_writer,
+        self->attributes,
+        get_timestamp(),
+        TASK_DEPENDENCE_PARAMETER,
+        predecessor_id);
+    self->events++;
+    return;
+}
+
+/* Get the source location of a construct, reserving its strings on first use.
+   Called while writing definitions */
+static const trace_source_t *
+trace_get_source(const void *codeptr_ra)
+{
+    static const trace_source_t unknown = {
+        .function = 0, .file = 0 /* "" */
+    };
+
+    if (codeptr_ra == NULL) return &unknown;
+
+    data_item_t item = {.ptr = NULL};
+    if (hashmap_find(source_cache, (uint64_t) codeptr_ra, &item))
+        return item.ptr;
+
+    trace_source_t *src = malloc(sizeof(*src));
+    *src = (trace_source_t) {
+        .function = get_unique_str_ref(),
+        .file     = get_unique_str_ref()
+    };
+
+    item = hashmap_insert(source_cache, (uint64_t) codeptr_ra,
+        (data_item_t) {.ptr = src});
+    if (item.ptr != src)
+    {
+        /* another thread got there first, or the cache is full. The refs just
+           reserved are written as "" */
+        if (item.ptr == NULL) LOG_WARN("source location cache is full");
+        OTF2_GlobalDefWriter_WriteString(Defs, src->function, "");
+        OTF2_GlobalDefWriter_WriteString(Defs, src->file, "");
+        free(src);
+        return item.ptr ? item.ptr : &unknown;
+    }
+    return src;
+}
+
+/* Resolve each construct's source location and write the strings reserved by
+   trace_get_source. No callbacks run now, so addr2line may be started for any
+   object */
+static void
+trace_write_source_strings(void)
+{
+    symbols_resolve_all();
+    pthread_mutex_lock(&lock_global_def_writer);
+
+    uint64_t codeptr_ra = 0;
+    data_item_t item = {.ptr = NULL};
+    size_t next = 0;
+    while (hashmap_scan(source_cache, &codeptr_ra, &item, &next))
+    {
+        const trace_source_t *src = item.ptr;
+        const symbol_info_t *sym = symbols_lookup((const void*) codeptr_ra,
+            true);
+        char file[DEFAULT_NAME_BUF_SZ+1] = {0};
+        if (sym != NULL && sym->file != NULL)
+            snprintf(file, DEFAULT_NAME_BUF_SZ, "%s:%u", sym->file, sym->line);
+        OTF2_GlobalDefWriter_WriteString(Defs, src->function,
+            sym != NULL && sym->function != NULL ? sym->function : "");
+        OTF2_GlobalDefWriter_WriteString(Defs, src->file, file);
+    }
+
+    pthread_mutex_unlock(&lock_global_def_writer);
+    return;
+}
+
+/* Write the group of all locations, then each thread team as a group of ranks
+   in it & a communicator referring to that group */
+static void
+trace_write_team_definitions(uint64_t n_locations)
+{
+    pthread_mutex_lock(&lock_global_def_writer);
+
+    uint64_t *members = malloc((n_locations + 1) * sizeof(*members));
+    uint64_t k = 0;
+    for (k=0; k<n_locations; k++) members[k] = k; /* location refs are dense */
+
+    OTF2_StringRef locations_name = get_unique_str_ref();
+    OTF2_StringRef team_name = get_unique_str_ref();
+    OTF2_GlobalDefWriter_WriteString(Defs, locations_name, "OpenMP threads");
+    OTF2_GlobalDefWriter_WriteString(Defs, team_name, "OpenMP thread team");
+
+    OTF2_GroupRef locations = get_unique_grp_ref();
+    OTF2_GlobalDefWriter_WriteGroup(Defs, locations, locations_name,
+        OTF2_GROUP_TYPE_COMM_LOCATIONS, OTF2_PARADIGM_OPENMP,
+        OTF2_GROUP_FLAG_NONE, n_locations, members);
+    free(members);
+
+    /* The initial team has only the initial thread */
+    OTF2_GroupRef group = get_unique_grp_ref();
+    uint64_t initial = initial_location_ref;
+    OTF2_GlobalDefWriter_WriteGroup(Defs, group, team_name,
+        OTF2_GROUP_TYPE_COMM_GROUP, OTF2_PARADIGM_OPENMP,
+        OTF2_GROUP_FLAG_NONE, 1, &initial);
+    OTF2_GlobalDefWriter_WriteComm(Defs, INITIAL_TEAM_COMM, team_name, group,
+        OTF2_UNDEFINED_COMM);
+
+    trace_team_def_t *team = NULL;
+    while (queue_pop(team_defs, (data_item_t*) &team))
+    {
+        group = get_unique_grp_ref();
+        OTF2_GlobalDefWriter_WriteGroup(Defs, group, team_name,
+            OTF2_GROUP_TYPE_COMM_GROUP, OTF2_PARADIGM_OPENMP,
+            OTF2_GROUP_FLAG_NONE, team->size, team->members);
+        OTF2_GlobalDefWriter_WriteComm(Defs, team->team, team_name, group,
+            OTF2_UNDEFINED_COMM);
+        free(team);
+    }
+    queue_destroy(team_defs, false, NULL);
+    team_defs = NULL;
+
+    pthread_mutex_unlock(&lock_global_def_writer);
+    return;
+}
+
+/* Define each counter as a member of the COUNTERS_METRIC class. Counters are
+   cumulative from when each thread opened them */
+static void
+trace_write_counter_definitions(unsigned int n)
+{
+    OTF2_MetricMemberRef members[COUNTERS_MAX] = {0};
+    unsigned int k=0;
+    for (k=0; k<n; k++)
+    {
+        const char *name = NULL, *description = NULL, *unit = NULL;
+        trace_counters_describe(k, &name, &description, &unit);
+        OTF2_StringRef name_ref = get_unique_str_ref();
+        OTF2_StringRef description_ref = get_unique_str_ref();
+        OTF2_StringRef unit_ref = get_unique_str_ref();
+        OTF2_GlobalDefWriter_WriteString(Defs, name_ref, name);
+        OTF2_GlobalDefWriter_WriteString(Defs, description_ref, description);
+        OTF2_GlobalDefWriter_WriteString(Defs, unit_ref, unit);
+        members[k] = k;
+        OTF2_GlobalDefWriter_WriteMetricMember(Defs, members[k], name_ref,
+            description_ref, OTF2_METRIC_TYPE_OTHER,
+            OTF2_METRIC_ACCUMULATED_START, OTF2_TYPE_UINT64,
+            OTF2_BASE_DECIMAL, 0, unit_ref);
+    }
+    OTF2_GlobalDefWriter_WriteMetricClass(Defs, COUNTERS_METRIC, n, members,
+        OTF2_METRIC_SYNCHRONOUS, OTF2_RECORDER_KIND_CPU);
+    return;
+}
+
+/* Write the current values of the location's counters, if it has any */
+static void
+trace_write_counters(trace_location_def_t *self, uint64_t time)
+{
+    if (self->counters == NULL) return;
+
+    uint64_t values[COUNTERS_MAX] = {0};
+    if (!trace_counters_read(self->counters, values)) return;
+
+    OTF2_Type types[COUNTERS_MAX];
+    OTF2_MetricValue metric_values[COUNTERS_MAX];
+    unsigned int k=0;
+    for (k=0; k<n_counters; k++)
+    {
+        types[k] = OTF2_TYPE_UINT64;
+        metric_values[k].unsigned_int = values[k];
+    }
+    OTF2_EvtWriter_Metric(self->evt_writer, NULL, time, COUNTERS_METRIC,
+        n_counters, types, metric_values);
+    self->events++;
+    return;
+}
+
+/* Get a string definition describing a histogram, such as "1:12 8:3", writing
+   it on first use. Identical histograms share one definition */
+static OTF2_StringRef
+trace_get_histogram_string(const uint64_t *histogram, unsigned int n_bins)
+{
+    char text[TASK_LATENCY_BINS * 32] = {0};
+    size_t len = 0;
+    int k=0;
+    for (k=0; k<n_bins; k++)
+    {
+        if (histogram[k] == 0) continue;
+        len += snprintf(&text[len], sizeof(text) - len, "%s%lu:%lu",
+            len > 0 ? " " : "", 1UL << k, histogram[k]);
+    }
+
+    return trace_get_string_ref(text);
+}
+
+/* Get the definition of a string, writing it on first use */
+static OTF2_StringRef
+trace_get_string_ref(const char *text)
+{
+    /* FNV-1a */
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const char *c = NULL;
+    for (c = text; *c != '\0'; c++)
+        hash = (hash ^ (unsigned char) *c) * 0x100000001b3ULL;
+
+    pthread_mutex_lock(&lock_global_def_writer);
+    data_item_t item = {.value = 0};
+    if (!hashmap_find(defined_strings, hash, &item))
+    {
+        item.value = get_unique_str_ref() + 1; /* items must be non-zero */
+        OTF2_GlobalDefWriter_WriteString(Defs, item.value - 1, text);
+        hashmap_insert(defined_strings, hash, item);
+    }
+    pthread_mutex_unlock(&lock_global_def_writer);
+    return (OTF2_StringRef) (item.value - 1);
+}
+
+/* Write the hardware topology as the system tree: the machine, then each NUMA
+   domain, socket, core and hardware thread. Otter's process is the machine's
+   only location group */
+static void
+trace_write_system_tree(const char *hostname)
+{
+    static const struct {const char *class; OTF2_SystemTreeDomain domain;}
+    levels[] = {
+        {"node",     OTF2_SYSTEM_TREE_DOMAIN_SHARED_MEMORY},
+        {"numa",     OTF2_SYSTEM_TREE_DOMAIN_NUMA},
+        {"socket",   OTF2_SYSTEM_TREE_DOMAIN_SOCKET},
+        {"core",     OTF2_SYSTEM_TREE_DOMAIN_CORE},
+        {"hwthread", OTF2_SYSTEM_TREE_DOMAIN_PU}
+    };
+    const int n_levels = sizeof(levels) / sizeof(levels[0]);
+
+    OTF2_StringRef class_ref[sizeof(levels) / sizeof(levels[0])];
+    int level=0;
+    for (level=0; level<n_levels; level++)
+    {
+        class_ref[level] = get_unique_str_ref();
+        OTF2_GlobalDefWriter_WriteString(Defs, class_ref[level],
+            levels[level].class);
+    }
+
+    /* The node at each level which contains the current CPU */
+    OTF2_SystemTreeNodeRef parent[sizeof(levels) / sizeof(levels[0])];
+    OTF2_SystemTreeNodeRef next_ref = DEFAULT_SYSTEM_TREE;
+    char name[DEFAULT_NAME_BUF_SZ + 1] = {0};
+
+    #define WRITE_NODE(level, parent_ref, ...)                                 \
+        do {                                                                   \
+            OTF2_StringRef name_ref = get_unique_str_ref();                    \
+            snprintf(name, DEFAULT_NAME_BUF_SZ, __VA_ARGS__);                  \
+            OTF2_GlobalDefWriter_WriteString(Defs, name_ref, name);            \
+            parent[level] = next_ref++;                                        \
+            OTF2_GlobalDefWriter_WriteSystemTreeNode(Defs, parent[level],      \
+                name_ref, class_ref[level], parent_ref);                       \
+            OTF2_GlobalDefWriter_WriteSystemTreeNodeDomain(Defs,               \
+                parent[level], levels[level].domain);                          \
+        } while (0)
+
+    WRITE_NODE(0, OTF2_UNDEFINED_SYSTEM_TREE_NODE, "%s", hostname);
+
+    size_t n_cpus = 0, k = 0;
+    const trace_cpu_topology_t *cpus = trace_topology_cpus(&n_cpus);
+    for (k=0; k<n_cpus; k++)
+    {
+        const trace_cpu_topology_t *cpu = &cpus[k];
+        const trace_cpu_topology_t *prev = k > 0 ? &cpus[k-1] : NULL;
+        bool new_numa = prev == NULL || cpu->numa != prev->numa;
+        bool new_socket = new_numa || cpu->package != prev->package;
+        bool new_core = new_socket || cpu->core != prev->core;
+        if (new_numa)
+            WRITE_NODE(1, parent[0], "NUMA domain %d", cpu->numa);
+        if (new_socket)
+            WRITE_NODE(2, parent[1], "socket %d", cpu->package);
+        if (new_core)
+            WRITE_NODE(3, parent[2], "core %d", cpu->core);
+        WRITE_NODE(4, parent[3], "CPU %d", cpu->cpu);
+    }
+    #undef WRITE_NODE
+    return;
+}
+
+/* Copy /proc/self/maps alongside the trace so that addresses recorded in it
+   can be resolved after the process has exited */
+static void
+trace_write_maps_snapshot(void)
+{
+    FILE *in = fopen("/proc/self/maps", "r");
+    FILE *out = fopen(maps_path, "w");
+    if (in == NULL || out == NULL)
+    {
+        LOG_WARN("failed to write memory map to %s", maps_path);
+        if (in) fclose(in);
+        if (out) fclose(out);
+        return;
+    }
+    char buf[4096];
+    size_t n = 0;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+    fclose(in);
+    fclose(out);
+    return;
+}
+
+/* Write a deferred enter event with its original timestamp */
+static void
+trace_flush_pending_enter(trace_location_def_t *self)
+{
+    trace_region_def_t *region = self->pending_enter;
+    if (region == NULL) return;
+    self->pending_enter = NULL;
+    OTF2_EvtWriter_Enter(self->evt_writer,
+        region->attributes, self->pending_enter_time, region->ref);
+    return;
+}
+
+/* The CPU on which the location's thread is running, counting a migration
+   whenever it differs from that at the thread's previous event */
+static int
+trace_location_cpu(trace_location_def_t *self)
+{
+    int cpu = sched_getcpu();
+    if (self->cpu >= 0 && cpu != self->cpu)
+    {
+        self->migrations++;
+        if (migration_markers)
+        {
+            char text[64] = {0};
+            snprintf(text, sizeof(text), "thread %lu moved from CPU %d to %d",
+                self->id, self->cpu, cpu);
+            trace_event_marker(self, trace_marker_migration, text);
+        }
+    }
+    self->cpu = cpu;
+    return cpu;
+}
+
+/* Write a marker scoped to a location, or to the whole trace if self is NULL */
+void
+trace_event_marker(
+    trace_location_def_t *self,
+    trace_marker_type_t   type,
+    const char           *text)
+{
+    pthread_mutex_lock(&lock_global_archive);
+    OTF2_MarkerWriter_WriteMarker(Markers,
+        get_timestamp(),
+        0, /* duration */
+        type,
+        self ? OTF2_MARKER_SCOPE_LOCATION : OTF2_MARKER_SCOPE_GLOBAL,
+        self ? self->ref : 0,
+        text);
+    pthread_mutex_unlock(&lock_global_archive);
+    return;
+}
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 /*  TIMESTAMP & UNIQUE REFERENCES                                            */
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-static uint64_t 
+uint64_t 
 get_timestamp(void)
 {
     struct timespec time;
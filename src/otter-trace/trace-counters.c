@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <macros/debug.h>
+#include <otter-common.h>
+#include <otter-trace/trace-counters.h>
+
+struct trace_counters_t {
+    int             fd[COUNTERS_MAX];   // fd[0] leads the group
+    unsigned int    n;
+};
+
+/* Layout of a group read with PERF_FORMAT_GROUP and the total times enabled &
+   running, which differ if the group was multiplexed with other events */
+typedef struct counters_read_t {
+    uint64_t        nr;
+    uint64_t        time_enabled;
+    uint64_t        time_running;
+    uint64_t        values[COUNTERS_MAX];
+} counters_read_t;
+
+static const struct {
+    unsigned int    flag;
+    const char     *name;
+    const char     *description;
+    const char     *unit;
+    uint32_t        type;
+    uint64_t        config;
+} counter_defs[] = {
+    {otter_counter_task_clock, "task-clock",
+        "time the thread was scheduled on a CPU", "ns",
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {otter_counter_context_switches, "context-switches",
+        "context switches of the thread", "#",
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {otter_counter_cpu_migrations, "cpu-migrations",
+        "migrations of the thread between CPUs", "#",
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {otter_counter_page_faults, "page-faults",
+        "page faults incurred by the thread", "#",
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {otter_counter_cycles, "cycles",
+        "CPU cycles (user mode)", "#",
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {otter_counter_instructions, "instructions",
+        "instructions retired (user mode)", "#",
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {otter_counter_llc_misses, "llc-misses",
+        "last-level cache misses (user mode)", "#",
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}
+};
+#define N_COUNTER_DEFS (sizeof(counter_defs) / sizeof(counter_defs[0]))
+
+/* The counters which could be opened: their index into counter_defs and
+   whether they could only count user-mode events */
+static struct {
+    unsigned int    def;
+    bool            user_only;
+} available[COUNTERS_MAX];
+static unsigned int n_available = 0;
+
+static int open_counter(unsigned int def, bool user_only, int group_fd);
+
+unsigned int
+trace_counters_initialise(unsigned int selected)
+{
+    n_available = 0;
+    if (selected == 0) return 0;
+
+    char names[256] = {0};
+    size_t len = 0;
+    unsigned int k=0;
+    for (k=0; k<N_COUNTER_DEFS && n_available<COUNTERS_MAX; k++)
+    {
+        if (!(selected & counter_defs[k].flag)) continue;
+
+        /* Software events such as context switches happen in the kernel, so
+           only exclude kernel mode if not allowed to count it */
+        bool user_only = counter_defs[k].type == PERF_TYPE_HARDWARE;
+        int fd = open_counter(k, user_only, -1);
+        if (fd < 0 && !user_only && (errno == EACCES || errno == EPERM))
+        {
+            errno = 0;
+            user_only = true;
+            fd = open_counter(k, user_only, -1);
+            LOG_WARN_IF((fd >= 0),
+                "counter %s only counts user-mode events", counter_defs[k].name);
+        }
+        if (fd < 0)
+        {
+            LOG_WARN("counter %s is unavailable: %s%s", counter_defs[k].name,
+                strerror(errno), (errno == EACCES || errno == EPERM) ?
+                    " (see /proc/sys/kernel/perf_event_paranoid)" : "");
+            errno = 0;
+            continue;
+        }
+        close(fd);
+        available[n_available].def = k;
+        available[n_available].user_only = user_only;
+        n_available++;
+        len += snprintf(&names[len], sizeof(names) - len, "%s%s",
+            len > 0 ? "," : "", counter_defs[k].name);
+    }
+
+    fprintf(stderr, "%-30s %s\n", "Performance counters:",
+        n_available > 0 ? names : "none available");
+    return n_available;
+}
+
+void
+trace_counters_describe(
+    unsigned int  k,
+    const char  **name,
+    const char  **description,
+    const char  **unit)
+{
+    *name        = counter_defs[available[k].def].name;
+    *description = counter_defs[available[k].def].description;
+    *unit        = counter_defs[available[k].def].unit;
+    return;
+}
+
+trace_counters_t *
+trace_counters_open(void)
+{
+    if (n_available == 0) return NULL;
+
+    trace_counters_t *counters = malloc(sizeof(*counters));
+    counters->n = 0;
+    unsigned int k=0;
+    for (k=0; k<n_available; k++)
+    {
+        int fd = open_counter(available[k].def, available[k].user_only,
+            k == 0 ? -1 : counters->fd[0]);
+        if (fd < 0)
+        {
+            /* All or none, so that every thread records the same counters */
+            LOG_WARN("couldn't open counter group on this thread (%s: %s)",
+                counter_defs[available[k].def].name, strerror(errno));
+            errno = 0;
+            trace_counters_close(counters);
+            return NULL;
+        }
+        counters->fd[counters->n++] = fd;
+    }
+    return counters;
+}
+
+bool
+trace_counters_read(trace_counters_t *counters, uint64_t *values)
+{
+    counters_read_t data = {0};
+    ssize_t size = read(counters->fd[0], &data, sizeof(data));
+    if (size < (ssize_t) (3 * sizeof(uint64_t)) || data.nr != counters->n
+        || data.time_running == 0)
+        return false;
+
+    /* The group is scheduled as a whole, so while it was multiplexed all of
+       its values are scaled up by the same ratio */
+    double scale = data.time_running < data.time_enabled ?
+        (double) data.time_enabled / data.time_running : 1.0;
+    unsigned int k=0;
+    for (k=0; k<counters->n; k++)
+        values[k] = scale == 1.0 ? data.values[k] :
+            (uint64_t) (data.values[k] * scale);
+    return true;
+}
+
+void
+trace_counters_close(trace_counters_t *counters)
+{
+    if (counters == NULL) return;
+
+    /* Close members before the group leader */
+    while (counters->n > 0) close(counters->fd[--counters->n]);
+    free(counters);
+    return;
+}
+
+/* Open a counter for the calling thread on any CPU */
+static int
+open_counter(unsigned int def, bool user_only, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = counter_defs[def].type;
+    attr.config         = counter_defs[def].config;
+    attr.read_format    = PERF_FORMAT_GROUP
+                        | PERF_FORMAT_TOTAL_TIME_ENABLED
+                        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = user_only;
+    attr.exclude_hv     = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
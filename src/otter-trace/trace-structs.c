@@ -1,8 +1,10 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <pthread.h>
 #include <time.h>
+#include <sched.h>
 #include <errno.h>
 #include <string.h>
 
@@ -15,14 +17,17 @@
 #include <otter-trace/trace.h>
 #include <otter-trace/trace-lookup-macros.h>
 #include <otter-trace/trace-structs.h>
+#include <otter-trace/trace-topology.h>
 
 #include <otter-datatypes/queue.h>
 #include <otter-datatypes/stack.h>
+#include <otter-datatypes/histogram.h>
 
 /* Defined in trace.c */
 extern OTF2_Archive *Archive;
 extern OTF2_GlobalDefWriter *Defs;
 extern pthread_mutex_t lock_global_def_writer;
+extern OTF2_LocationRef initial_location_ref;
 extern pthread_mutex_t lock_global_archive;
 
 /* * * * * * * * * * * * * * * * */
@@ -48,12 +53,28 @@ trace_new_location_definition(
         .rgn_stack      = stack_create(),
         .rgn_defs       = queue_create(),
         .rgn_defs_stack = stack_create(),
-        .attributes     = OTF2_AttributeList_New()
+        .attributes     = OTF2_AttributeList_New(),
+        .pending_enter  = NULL,
+        .pending_enter_time = 0,
+        .tasks_started  = 0,
+        .tasks_stolen   = 0,
+        .tasks_remote   = 0,
+        .task_start_latency = 0,
+        .task_queued_time   = 0,
+        .task_latency_histogram = {0},
+        .counters       = trace_counters_open(),
+        .cpu            = -1,
+        .place          = -1,
+        .affinity       = 0,
+        .migrations     = 0
     };
 
     new->evt_writer = OTF2_Archive_GetEvtWriter(Archive, new->ref);
     new->def_writer = OTF2_Archive_GetDefWriter(Archive, new->ref);
 
+    /* The initial thread is the only member of the initial team */
+    if (thread_type == ompt_thread_initial) initial_location_ref = new->ref;
+
     /* Thread location definition is written at thread-end (once all events
        counted) */
 
@@ -71,7 +92,11 @@ trace_new_parallel_region(
     unique_id_t    master,
     unique_id_t    encountering_task_id,
     int            flags,
-    unsigned int   requested_parallelism)
+    unsigned int   requested_parallelism,
+    uint64_t       skipped_instances,
+    uint64_t       skipped_time,
+    const void    *codeptr_ra,
+    uint32_t       callstack_id)
 {
     trace_region_def_t *new = malloc(sizeof(*new));
     *new = (trace_region_def_t) {
@@ -80,11 +105,28 @@ trace_new_parallel_region(
         .attributes = OTF2_AttributeList_New(),
         .type       = trace_region_parallel,
         .encountering_task_id = encountering_task_id,
+        .codeptr_ra = codeptr_ra,
+        .callstack_id = callstack_id,
         .attr.parallel = {
             .id            = id,
             .master_thread = master,
             .is_league     = flags & ompt_parallel_league ? true : false,
             .requested_parallelism = requested_parallelism,
+            .skipped_instances = skipped_instances,
+            .skipped_time  = skipped_time,
+            .throttled_tasks     = 0,
+            .throttled_task_time = 0,
+            .barriers      = 0,
+            .barrier_skew  = 0,
+            .max_barrier_skew = 0,
+            .barrier_wait  = 0,
+            .category_tasks = {0},
+            .category_time = {0},
+            .production    = {0},
+            .team          = get_unique_comm_ref(),
+            .members       = calloc(requested_parallelism, sizeof(uint64_t)),
+            .team_size     = 0,
+            .peak_threads  = 0,
             .ref_count     = 0,
             .enter_count   = 0,
             .lock_rgn      = PTHREAD_MUTEX_INITIALIZER,
@@ -99,7 +141,8 @@ trace_new_workshare_region(
     trace_location_def_t *loc,
     ompt_work_t           wstype, 
     uint64_t              count,
-    unique_id_t           encountering_task_id)
+    unique_id_t           encountering_task_id,
+    const void           *codeptr_ra)
 {
     trace_region_def_t *new = malloc(sizeof(*new));
     *new = (trace_region_def_t) {
@@ -108,6 +151,7 @@ trace_new_workshare_region(
         .attributes = OTF2_AttributeList_New(),
         .type       = trace_region_workshare,
         .encountering_task_id = encountering_task_id,
+        .codeptr_ra = codeptr_ra,
         .attr.wshare = {
             .type       = wstype,
             .count      = count
@@ -126,7 +170,8 @@ trace_new_workshare_region(
 trace_region_def_t *
 trace_new_master_region(
     trace_location_def_t *loc,
-    unique_id_t           encountering_task_id)
+    unique_id_t           encountering_task_id,
+    const void           *codeptr_ra)
 {
     trace_region_def_t *new = malloc(sizeof(*new));
     *new = (trace_region_def_t) {
@@ -135,6 +180,7 @@ trace_new_master_region(
         .attributes = OTF2_AttributeList_New(),
         .type       = trace_region_master,
         .encountering_task_id = encountering_task_id,
+        .codeptr_ra = codeptr_ra,
         .attr.master = {
             .thread = loc->id
         }
@@ -153,7 +199,8 @@ trace_region_def_t *
 trace_new_sync_region(
     trace_location_def_t *loc,
     ompt_sync_region_t    stype, 
-    unique_id_t           encountering_task_id)
+    unique_id_t           encountering_task_id,
+    const void           *codeptr_ra)
 {
     trace_region_def_t *new = malloc(sizeof(*new));
     *new = (trace_region_def_t) {
@@ -162,8 +209,11 @@ trace_new_sync_region(
         .attributes = OTF2_AttributeList_New(),
         .type       = trace_region_synchronise,
         .encountering_task_id = encountering_task_id,
+        .codeptr_ra = codeptr_ra,
         .attr.sync = {
             .type = stype,
+            .task_descendant = false,
+            .descendant_time = 0
         }
     };
 
@@ -182,7 +232,9 @@ trace_new_task_region(
     trace_region_def_t    *parent_task_region, 
     unique_id_t            id,
     ompt_task_flag_t       flags,
-    int                    has_dependences)
+    int                    has_dependences,
+    const void            *codeptr_ra,
+    uint32_t               callstack_id)
 {
     /* Create a region representing a task. Add to the location's region
        definition queue. */
@@ -196,6 +248,8 @@ trace_new_task_region(
         .role = OTF2_REGION_ROLE_TASK,
         .attributes = OTF2_AttributeList_New(),
         .type = trace_region_task,
+        .codeptr_ra = codeptr_ra,
+        .callstack_id = callstack_id,
         .attr.task = {
             .id              = id,
             .type            = flags & 0xF,
@@ -205,7 +259,18 @@ trace_new_task_region(
                 parent_task_region->attr.task.id   : OTF2_UNDEFINED_UINT64,
             .parent_type = parent_task_region != NULL ? 
                 parent_task_region->attr.task.type : OTF2_UNDEFINED_UINT32,
-            .task_status     = 0 /* no status */
+            .task_status     = 0, /* no status */
+            .untraced_descendants     = 0,
+            .untraced_descendant_time = 0,
+            .team            = INITIAL_TEAM_COMM,
+            .creating_thread = 0,
+            .generation      = 0,
+            .started         = false,
+            .stolen          = false,
+            .remote          = false,
+            .creating_numa   = -1,
+            .start_latency   = 0,
+            .queued_time     = 0
         }
     };
     new->encountering_task_id = new->attr.task.parent_id;
@@ -219,6 +284,166 @@ trace_new_task_region(
     return new;
 }
 
+/* Descendants may be executed by any thread, so update atomically */
+void
+trace_add_untraced_descendants(
+    trace_region_def_t *task_rgn,
+    uint64_t            count,
+    uint64_t            time)
+{
+    if (task_rgn == NULL || task_rgn->type != trace_region_task)
+    {
+        LOG_ERROR("invalid task region %p", task_rgn);
+        return;
+    }
+    if (count > 0) __sync_fetch_and_add(
+        &task_rgn->attr.task.untraced_descendants, count);
+    if (time > 0) __sync_fetch_and_add(
+        &task_rgn->attr.task.untraced_descendant_time, time);
+    return;
+}
+
+void
+trace_add_task_category(
+    trace_region_def_t    *parallel_rgn,
+    trace_task_category_t  category,
+    uint64_t               count,
+    uint64_t               time)
+{
+    if (parallel_rgn == NULL || parallel_rgn->type != trace_region_parallel)
+    {
+        LOG_ERROR("invalid parallel region %p", parallel_rgn);
+        return;
+    }
+    trace_parallel_region_attr_t *parallel = &parallel_rgn->attr.parallel;
+    if (count > 0) __sync_fetch_and_add(
+        &parallel->category_tasks[category], count);
+    if (time > 0) __sync_fetch_and_add(
+        &parallel->category_time[category], time);
+    return;
+}
+
+/* Only the last thread to arrive at a barrier updates these, and the team's
+   barriers are completed one at a time */
+void
+trace_add_barrier_arrivals(
+    trace_region_def_t *parallel_rgn,
+    uint64_t            skew,
+    uint64_t            wait)
+{
+    if (parallel_rgn == NULL || parallel_rgn->type != trace_region_parallel)
+    {
+        LOG_ERROR("invalid parallel region %p", parallel_rgn);
+        return;
+    }
+    trace_parallel_region_attr_t *parallel = &parallel_rgn->attr.parallel;
+    __sync_fetch_and_add(&parallel->barriers, 1);
+    __sync_fetch_and_add(&parallel->barrier_skew, skew);
+    __sync_fetch_and_add(&parallel->barrier_wait, wait);
+    if (skew > parallel->max_barrier_skew)
+        __atomic_store_n(&parallel->max_barrier_skew, skew, __ATOMIC_RELAXED);
+    return;
+}
+
+void
+trace_set_task_production(
+    trace_region_def_t              *parallel_rgn,
+    const trace_task_production_t   *production)
+{
+    if (parallel_rgn == NULL || parallel_rgn->type != trace_region_parallel)
+    {
+        LOG_ERROR("invalid parallel region %p", parallel_rgn);
+        return;
+    }
+    pthread_mutex_lock(&parallel_rgn->attr.parallel.lock_rgn);
+    parallel_rgn->attr.parallel.production = *production;
+    pthread_mutex_unlock(&parallel_rgn->attr.parallel.lock_rgn);
+    return;
+}
+
+void
+trace_add_throttled_tasks(
+    trace_region_def_t *parallel_rgn,
+    uint64_t            count,
+    uint64_t            time)
+{
+    if (parallel_rgn == NULL || parallel_rgn->type != trace_region_parallel)
+    {
+        LOG_ERROR("invalid parallel region %p", parallel_rgn);
+        return;
+    }
+    if (count > 0) __sync_fetch_and_add(
+        &parallel_rgn->attr.parallel.throttled_tasks, count);
+    if (time > 0) __sync_fetch_and_add(
+        &parallel_rgn->attr.parallel.throttled_task_time, time);
+    return;
+}
+
+void
+trace_add_task_start(
+    trace_location_def_t *loc,
+    trace_region_def_t   *task_rgn,
+    uint64_t              latency,
+    uint64_t              queued,
+    bool                  stolen)
+{
+    loc->tasks_started++;
+    if (stolen) loc->tasks_stolen++;
+    loc->task_start_latency += latency;
+    loc->task_queued_time += queued;
+    histogram_add(loc->task_latency_histogram, TASK_LATENCY_BINS, latency);
+
+    if (task_rgn == NULL) return;
+    int numa = trace_topology_numa_node(sched_getcpu());
+    bool remote = task_rgn->attr.task.creating_numa >= 0 && numa >= 0
+        && numa != task_rgn->attr.task.creating_numa;
+    if (remote) loc->tasks_remote++;
+    task_rgn->attr.task.started = true;
+    task_rgn->attr.task.stolen = stolen;
+    task_rgn->attr.task.remote = remote;
+    task_rgn->attr.task.start_latency = latency;
+    task_rgn->attr.task.queued_time = queued;
+    return;
+}
+
+void
+trace_add_team_member(
+    trace_region_def_t   *parallel_rgn,
+    unsigned int          index,
+    unsigned int          team_size,
+    unsigned int          live_threads,
+    trace_location_def_t *loc)
+{
+    trace_parallel_region_attr_t *parallel = &parallel_rgn->attr.parallel;
+    if (index >= parallel->requested_parallelism)
+    {
+        LOG_ERROR("thread %u is outside the team of parallel region %lu (%u)",
+            index, parallel->id, parallel->requested_parallelism);
+        return;
+    }
+    parallel->members[index] = loc->ref;
+    __atomic_store_n(&parallel->team_size, team_size, __ATOMIC_RELAXED);
+    unsigned int peak = __atomic_load_n(&parallel->peak_threads, __ATOMIC_RELAXED);
+    while (live_threads > peak && !__atomic_compare_exchange_n(
+        &parallel->peak_threads, &peak, live_threads,
+        false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return;
+}
+
+void
+trace_set_task_identity(
+    trace_region_def_t *task_rgn,
+    trace_region_def_t *parallel_rgn,
+    uint32_t            creating_thread,
+    uint32_t            generation)
+{
+    task_rgn->attr.task.team = parallel_rgn != NULL ?
+        parallel_rgn->attr.parallel.team : INITIAL_TEAM_COMM;
+    task_rgn->attr.task.creating_thread = creating_thread;
+    task_rgn->attr.task.generation = generation;
+    return;
+}
+
 /* * * * * * * * * * * * * * * */
 /* * * * * Destructors * * * * */
 /* * * * * * * * * * * * * * * */
@@ -228,6 +453,7 @@ trace_destroy_location(trace_location_def_t *loc)
 {
     if (loc == NULL) return;
     trace_write_location_definition(loc);
+    trace_counters_close(loc->counters);
     LOG_DEBUG("[t=%lu] destroying rgn_stack %p", loc->id, loc->rgn_stack);
     stack_destroy(loc->rgn_stack, false, NULL);
     if (loc->rgn_defs)
@@ -304,6 +530,7 @@ trace_destroy_parallel_region(trace_region_def_t *rgn)
        and all definitions written */
     // OTF2_AttributeList_Delete(rgn->attributes);
     queue_destroy(rgn->attr.parallel.rgn_defs, false, NULL);
+    free(rgn->attr.parallel.members);
     LOG_DEBUG("region %p (parallel id %lu)", rgn, rgn->attr.parallel.id);
     free(rgn);
     return;
@@ -0,0 +1,287 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <elf.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/auxv.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <macros/debug.h>
+#include <otter-trace/trace-symbols.h>
+#include <otter-datatypes/hashmap.h>
+
+/* Maximum number of distinct addresses resolved */
+#define SYMBOL_CACHE_CAPACITY 8192
+
+static hashmap_t *symbol_cache = NULL;
+
+extern char **environ;
+
+/* A running "addr2line -f -e <object>", which answers each address written to
+   it with the function name, then "file:line". Talked to over a socket rather
+   than pipes so that a resolver which exits can't raise SIGPIPE in the
+   application */
+typedef struct resolver_t {
+    const void         *base;       // object's load address (dli_fbase)
+    pid_t               pid;
+    int                 fd;
+    FILE               *from;       // NULL if addr2line couldn't be started
+    struct resolver_t  *next;
+} resolver_t;
+
+/* Resolvers & line lookups are serialised. Protected by lock_addr2line */
+static pthread_mutex_t lock_addr2line = PTHREAD_MUTEX_INITIALIZER;
+static resolver_t *resolvers = NULL;
+static bool        start_any = false;   // start resolvers for any object
+
+static resolver_t *get_resolver(const Dl_info *info, bool start);
+static void stop_resolver(resolver_t *resolver);
+static void resolve_line(symbol_info_t *sym, resolver_t *resolver,
+    const Dl_info *info);
+static void symbol_destroy(void *ptr);
+
+void
+symbols_initialise(void)
+{
+    symbol_cache = hashmap_create(SYMBOL_CACHE_CAPACITY);
+    return;
+}
+
+void
+symbols_resolve_executable(void)
+{
+    /* The program headers are mapped with the rest of the executable */
+    Dl_info info;
+    const void *phdr = (const void*) getauxval(AT_PHDR);
+    pthread_mutex_lock(&lock_addr2line);
+    if (phdr != NULL && dladdr(phdr, &info) != 0) get_resolver(&info, true);
+    pthread_mutex_unlock(&lock_addr2line);
+    return;
+}
+
+void
+symbols_resolve_all(void)
+{
+    pthread_mutex_lock(&lock_addr2line);
+    start_any = true;
+    pthread_mutex_unlock(&lock_addr2line);
+    return;
+}
+
+void
+symbols_finalise(void)
+{
+    /* addr2line exits once its input is closed */
+    pthread_mutex_lock(&lock_addr2line);
+    while (resolvers != NULL)
+    {
+        resolver_t *resolver = resolvers;
+        resolvers = resolver->next;
+        stop_resolver(resolver);
+        free(resolver);
+    }
+    start_any = false;
+    pthread_mutex_unlock(&lock_addr2line);
+
+    hashmap_destroy(symbol_cache, true, symbol_destroy);
+    symbol_cache = NULL;
+    return;
+}
+
+const symbol_info_t *
+symbols_lookup(const void *addr, bool need_line)
+{
+    data_item_t item = {.ptr = NULL};
+    symbol_info_t *sym = NULL;
+
+    if (hashmap_find(symbol_cache, (uint64_t) addr, &item))
+    {
+        sym = item.ptr;
+        if (!need_line || __atomic_load_n(&sym->line_resolved, __ATOMIC_ACQUIRE))
+            return sym;
+    } else {
+        sym = malloc(sizeof(*sym));
+        *sym = (symbol_info_t) {
+            .addr          = addr,
+            .object        = NULL,
+            .function      = NULL,
+            .file          = NULL,
+            .line          = 0,
+            .line_resolved = false
+        };
+        Dl_info info;
+        if (dladdr(addr, &info) != 0)
+        {
+            sym->object = info.dli_fname ? strdup(info.dli_fname) : NULL;
+            sym->function = info.dli_sname ? strdup(info.dli_sname) : NULL;
+        }
+        item = hashmap_insert(symbol_cache, (uint64_t) addr,
+            (data_item_t) {.ptr = sym});
+        if (item.ptr != sym)
+        {
+            /* another thread got there first, or the cache is full */
+            symbol_destroy(sym);
+            if (item.ptr == NULL) return NULL;
+            sym = item.ptr;
+        }
+    }
+
+    if (need_line)
+    {
+        pthread_mutex_lock(&lock_addr2line);
+        if (!sym->line_resolved)
+        {
+            /* Without a resolver for its object the address is left to be
+               resolved once resolvers may be started */
+            Dl_info info;
+            bool resolved = true;
+            if (dladdr(addr, &info) != 0)
+            {
+                resolver_t *resolver = get_resolver(&info, start_any);
+                if (resolver != NULL) resolve_line(sym, resolver, &info);
+                else resolved = start_any;
+            }
+            if (resolved)
+                __atomic_store_n(&sym->line_resolved, true, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&lock_addr2line);
+    }
+
+    return sym;
+}
+
+/* Find the resolver for an object, starting it if allowed. Returns NULL if
+   there is none or addr2line couldn't be started. Called with lock_addr2line
+   held */
+static resolver_t *
+get_resolver(const Dl_info *info, bool start)
+{
+    resolver_t *resolver = resolvers;
+    while (resolver != NULL && resolver->base != info->dli_fbase)
+        resolver = resolver->next;
+    if (resolver != NULL) return resolver->from ? resolver : NULL;
+    if (!start || info->dli_fname == NULL || info->dli_fbase == NULL)
+        return NULL;
+
+    resolver = malloc(sizeof(*resolver));
+    *resolver = (resolver_t) {
+        .base = info->dli_fbase,
+        .pid  = 0,
+        .fd   = -1,
+        .from = NULL,
+        .next = resolvers
+    };
+    resolvers = resolver;
+
+    int sv[2] = {-1, -1};
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+    {
+        LOG_WARN("failed to create a socket for addr2line");
+        return NULL;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+        O_WRONLY, 0);
+    char *argv[] = {"addr2line", "-f", "-e", (char*) info->dli_fname, NULL};
+    int err = posix_spawnp(&resolver->pid, "addr2line", &actions, NULL, argv,
+        environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(sv[1]);
+
+    if (err != 0)
+    {
+        LOG_WARN("failed to run addr2line for %s", info->dli_fname);
+        close(sv[0]);
+        return NULL;
+    }
+    resolver->fd = sv[0];
+    resolver->from = fdopen(sv[0], "r");
+    LOG_DEBUG("started addr2line for %s (pid %d)", info->dli_fname,
+        resolver->pid);
+    return resolver->from ? resolver : NULL;
+}
+
+static void
+stop_resolver(resolver_t *resolver)
+{
+    if (resolver->from == NULL) return;
+    fclose(resolver->from);
+    waitpid(resolver->pid, NULL, 0);
+    resolver->from = NULL;
+    return;
+}
+
+/* Ask addr2line for the file & line of the call preceding a return address.
+   Addresses in position-independent objects are given relative to the object's
+   base address. The results are published before line_resolved, and function
+   only if dladdr found none, with atomic stores as other threads may read the
+   symbol without lock_addr2line */
+static void
+resolve_line(symbol_info_t *sym, resolver_t *resolver, const Dl_info *info)
+{
+    uintptr_t addr = (uintptr_t) sym->addr - 1;
+    const ElfW(Ehdr) *ehdr = info->dli_fbase;
+    if (ehdr->e_type == ET_DYN) addr -= (uintptr_t) info->dli_fbase;
+
+    char buf[PATH_MAX + 32] = {0};
+    int len = snprintf(buf, sizeof(buf), "0x%lx\n", addr);
+    if (send(resolver->fd, buf, len, MSG_NOSIGNAL) != len
+        || fgets(buf, sizeof(buf), resolver->from) == NULL)
+    {
+        LOG_WARN("addr2line for %s stopped", info->dli_fname);
+        stop_resolver(resolver);
+        return;
+    }
+
+    /* Both lines are "??" if there is no debug info. dladdr only finds
+       exported functions, so prefer the name from the debug info if dladdr
+       found none */
+    char *function = NULL, *file = NULL;
+    unsigned int line = 0;
+    buf[strcspn(buf, "\n")] = '\0';
+    if (strcmp(buf, "??") != 0) function = strdup(buf);
+    if (fgets(buf, sizeof(buf), resolver->from) != NULL)
+    {
+        buf[strcspn(buf, " \n")] = '\0';
+        char *colon = strrchr(buf, ':');
+        if (colon != NULL && strncmp(buf, "??", 2) != 0)
+        {
+            *colon = '\0';
+            line = (unsigned int) strtoul(colon + 1, NULL, 10);
+            file = strdup(buf);
+        }
+    }
+
+    if (function != NULL && sym->function == NULL)
+        __atomic_store_n(&sym->function, function, __ATOMIC_RELEASE);
+    else
+        free(function);
+    __atomic_store_n(&sym->line, line, __ATOMIC_RELAXED);
+    __atomic_store_n(&sym->file, file, __ATOMIC_RELEASE);
+
+    LOG_DEBUG("%p resolved to %s:%u", sym->addr, file ? file : "??", line);
+    return;
+}
+
+static void
+symbol_destroy(void *ptr)
+{
+    symbol_info_t *sym = ptr;
+    free((char*) sym->object);
+    free((char*) sym->function);
+    free((char*) sym->file);
+    free(sym);
+    return;
+}
@@ -0,0 +1,171 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+#include <sched.h>
+
+#include <macros/debug.h>
+#include <otter-trace/trace-topology.h>
+
+#define SYSFS_CPU  "/sys/devices/system/cpu"
+#define SYSFS_NODE "/sys/devices/system/node"
+
+static trace_cpu_topology_t *cpus = NULL;
+static size_t n_online = 0;
+
+/* NUMA domain of each CPU, indexed by CPU number */
+static int numa_of[CPU_SETSIZE];
+
+static bool read_cpulist(const char *path, cpu_set_t *set);
+static void write_cpulist(const cpu_set_t *set, char *buf, size_t size);
+static int read_int(const char *path, int fallback);
+static int compare_cpus(const void *a, const void *b);
+
+void
+trace_topology_initialise(void)
+{
+    int cpu=0;
+    for (cpu=0; cpu<CPU_SETSIZE; cpu++) numa_of[cpu] = -1;
+
+    cpu_set_t online;
+    if (!read_cpulist(SYSFS_CPU "/online", &online))
+    {
+        LOG_WARN("couldn't read online CPUs from %s", SYSFS_CPU "/online");
+        CPU_ZERO(&online);
+        if (sched_getaffinity(0, sizeof(online), &online) != 0) return;
+    }
+
+    /* Each NUMA domain lists its CPUs. Without any, all CPUs are in one */
+    DIR *dir = opendir(SYSFS_NODE);
+    struct dirent *entry = NULL;
+    while (dir != NULL && (entry = readdir(dir)) != NULL)
+    {
+        int node = 0;
+        if (sscanf(entry->d_name, "node%d", &node) != 1) continue;
+        char path[64] = {0};
+        cpu_set_t node_cpus;
+        snprintf(path, sizeof(path), SYSFS_NODE "/node%d/cpulist", node);
+        if (!read_cpulist(path, &node_cpus)) continue;
+        for (cpu=0; cpu<CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &node_cpus)) numa_of[cpu] = node;
+    }
+    if (dir != NULL) closedir(dir);
+
+    cpus = malloc(CPU_COUNT(&online) * sizeof(*cpus));
+    n_online = 0;
+    for (cpu=0; cpu<CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &online)) continue;
+        if (numa_of[cpu] < 0) numa_of[cpu] = 0;
+        char path[96] = {0};
+        trace_cpu_topology_t *t = &cpus[n_online++];
+        t->cpu  = cpu;
+        t->numa = numa_of[cpu];
+        snprintf(path, sizeof(path),
+            SYSFS_CPU "/cpu%d/topology/physical_package_id", cpu);
+        t->package = read_int(path, 0);
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/core_id", cpu);
+        t->core = read_int(path, 0);
+    }
+    qsort(cpus, n_online, sizeof(*cpus), compare_cpus);
+    return;
+}
+
+void
+trace_topology_finalise(void)
+{
+    free(cpus);
+    cpus = NULL;
+    n_online = 0;
+    return;
+}
+
+const trace_cpu_topology_t *
+trace_topology_cpus(size_t *n_cpus)
+{
+    *n_cpus = n_online;
+    return cpus;
+}
+
+int
+trace_topology_numa_node(int cpu)
+{
+    return (cpu >= 0 && cpu < CPU_SETSIZE) ? numa_of[cpu] : -1;
+}
+
+void
+trace_topology_affinity(char *buf, size_t size)
+{
+    cpu_set_t set;
+    buf[0] = '\0';
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return;
+    write_cpulist(&set, buf, size);
+    return;
+}
+
+static void
+write_cpulist(const cpu_set_t *set, char *buf, size_t size)
+{
+    size_t len = 0;
+    buf[0] = '\0';
+    int cpu=0;
+    while (cpu < CPU_SETSIZE && len < size)
+    {
+        if (!CPU_ISSET(cpu, set)) { cpu++; continue; }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set)) last++;
+        len += snprintf(&buf[len], size - len, last > cpu ? "%s%d-%d" : "%s%d",
+            len > 0 ? "," : "", cpu, last);
+        cpu = last + 1;
+    }
+    return;
+}
+
+/* Read a sysfs list of CPU ranges such as "0-3,8" */
+static bool
+read_cpulist(const char *path, cpu_set_t *set)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return false;
+    char text[4096] = {0};
+    bool ok = fgets(text, sizeof(text), file) != NULL;
+    fclose(file);
+    if (!ok) return false;
+
+    CPU_ZERO(set);
+    char *save = NULL;
+    for (char *tok = strtok_r(text, ",\n", &save); tok != NULL;
+        tok = strtok_r(NULL, ",\n", &save))
+    {
+        int first = 0, last = 0;
+        int n = sscanf(tok, "%d-%d", &first, &last);
+        if (n < 1) continue;
+        if (n == 1) last = first;
+        for (; first <= last && first < CPU_SETSIZE; first++)
+            CPU_SET(first, set);
+    }
+    return true;
+}
+
+static int
+read_int(const char *path, int fallback)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return fallback;
+    int value = fallback;
+    if (fscanf(file, "%d", &value) != 1) value = fallback;
+    fclose(file);
+    return value;
+}
+
+static int
+compare_cpus(const void *a, const void *b)
+{
+    const trace_cpu_topology_t *x = a, *y = b;
+    if (x->numa != y->numa) return x->numa - y->numa;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
@@ -133,7 +133,11 @@ def yield_chunks(tr):
     nChunks = 0
     print("yielding chunks:", end=" ", flush=True)
     for location, event in tr.events:
-        if type(event) in [otf2.events.ThreadBegin, otf2.events.ThreadEnd]:
+        if type(event) in [otf2.events.ThreadBegin, otf2.events.ThreadEnd,
+                           otf2.events.ThreadTaskSwitch,
+                           otf2.events.ThreadTaskComplete,
+                           otf2.events.ParameterUnsignedInt,
+                           otf2.events.Metric]:
             continue
         if event_defines_new_chunk(event, attr):
             # Event marks transition from one chunk to another